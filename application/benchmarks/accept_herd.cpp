@@ -0,0 +1,127 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Several engines, each on its own thread, monitor one listening socket while a client opens connections to
+// it.  Without mode::exclusive every engine wakes for every connection and all but one find nothing to accept.
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+
+struct listener_tag {};
+
+typedef handle<listener_tag, int, -1> listener_handle;
+
+
+struct acceptor {
+   void on_activation(mode flags) {
+      (void)flags;
+      wakeups.fetch_add(1, std::memory_order_relaxed);
+      for (;;) {
+         int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+         if (fd < 0) {
+            break;
+         }
+         (void)::close(fd);
+         accepted.fetch_add(1, std::memory_order_relaxed);
+      }
+   }
+
+   int listener;
+   std::atomic<unsigned long> &accepted;
+   std::atomic<unsigned long> &wakeups;
+};
+
+
+int create_listener(sockaddr_in &address) {
+   int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   address = {};
+   address.sin_family = AF_INET;
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   socklen_t length = sizeof(address);
+   if ((fd < 0) ||
+       (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) ||
+       (::listen(fd, SOMAXCONN) != 0) ||
+       (::getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length) != 0)) {
+      std::perror("listener");
+      std::exit(1);
+   }
+   return fd;
+}
+
+
+void run(const char *name, mode flags, std::size_t num_engines, unsigned long connections) {
+   sockaddr_in address;
+   int listener = create_listener(address);
+   std::atomic<unsigned long> accepted{0};
+   std::atomic<unsigned long> wakeups{0};
+
+   std::vector<std::shared_ptr<event_engine<epoll_service>>> engines;
+   std::vector<std::future<std::error_code>> loops;
+   std::vector<std::unique_ptr<acceptor>> acceptors;
+   for (std::size_t i = 0; i < num_engines; ++i) {
+      engines.emplace_back(std::make_shared<event_engine<epoll_service>>(64));
+      acceptors.emplace_back(new acceptor{listener, accepted, wakeups});
+      engines.back()->start_monitoring<acceptor, &acceptor::on_activation>(listener_handle{listener}, flags, *acceptors.back());
+      auto engine = engines.back();
+      loops.emplace_back(std::async(std::launch::async, [engine] { return engine->run(); }));
+   }
+
+   auto start = steady_clock::now();
+   for (unsigned long i = 0; i < connections; ++i) {
+      int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+         std::perror("connect");
+      }
+      (void)::close(fd);
+   }
+   auto deadline = steady_clock::now() + 10s;
+   while ((accepted.load() < connections) && (steady_clock::now() < deadline)) {
+      std::this_thread::yield();
+   }
+   auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+   for (auto &engine : engines) {
+      engine->quit();
+   }
+   for (auto &loop : loops) {
+      (void)loop.get();
+   }
+   engines.clear();
+   (void)::close(listener);
+
+   std::printf("%-10s engines=%-3zu accepted=%-8lu accepts/s=%-10.0f wakeups/accept=%.3f\n",
+               name, num_engines, accepted.load(),
+               static_cast<double>(accepted.load()) * 1e9 / static_cast<double>(elapsed.count()),
+               static_cast<double>(wakeups.load()) / static_cast<double>(accepted.load()));
+}
+
+}
+
+
+int main(int argc, char **argv) {
+   std::size_t engines = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4;
+   unsigned long connections = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 10000;
+
+   run("shared", mode::read, engines, connections);
+   run("exclusive", mode::read | mode::exclusive, engines, connections);
+   return 0;
+}
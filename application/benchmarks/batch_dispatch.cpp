@@ -0,0 +1,134 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Cost per event of an epoll_service poll that finds thousands of descriptors ready at once, dispatched in the
+// order the kernel returns them without prefetching, with the target objects prefetched ahead of dispatch, and
+// prefetched as well as grouped by handler.  Every descriptor is an eventfd whose handler is one of a few kinds,
+// and handler state is scattered well past the last level cache.  Only the polls are timed; making the eventfds
+// ready again between polls is not.
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace epolling;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+struct counter_tag {};
+
+typedef handle<counter_tag, int, -1> counter_handle;
+
+// Stands in for per-connection state: each event reads and writes the first of a few cache lines.
+struct alignas(64) connection {
+   void on_read(mode flags) {
+      count += static_cast<long>(flags);
+   }
+
+   void on_write(mode flags) {
+      count += 2 * static_cast<long>(flags);
+   }
+
+   void on_hangup(mode flags) {
+      count += 3 * static_cast<long>(flags);
+   }
+
+   long count = 0;
+   char padding[192];
+};
+
+
+struct setup {
+   std::vector<connection> objects;
+   std::vector<int> fds;
+   // Spreads the handlers of neighbouring descriptors apart so that none of them share cache lines.
+   std::vector<std::size_t> placement;
+};
+
+
+void run(const char *name, setup &s, std::size_t prefetch_distance, bool grouped, std::size_t rounds) {
+   auto engine = std::make_shared<event_engine<epoll_service>>(s.fds.size());
+   auto &service = std::experimental::use_service<epoll_service>(*engine);
+   service.set_prefetch_distance(prefetch_distance);
+   service.set_grouped_dispatch(grouped);
+
+   for (std::size_t i = 0U; i < s.fds.size(); ++i) {
+      counter_handle h{s.fds[i]};
+      connection &object = s.objects[s.placement[i]];
+      switch (i % 3U) {
+         case 0U:
+            engine->start_monitoring<connection, &connection::on_read>(h, mode::read, object);
+            break;
+         case 1U:
+            engine->start_monitoring<connection, &connection::on_write>(h, mode::read, object);
+            break;
+         default:
+            engine->start_monitoring<connection, &connection::on_hangup>(h, mode::read, object);
+            break;
+      }
+   }
+
+   nanoseconds elapsed{0};
+   for (std::size_t round = 0U; round < rounds; ++round) {
+      for (int fd : s.fds) {
+         (void)::eventfd_write(fd, 1U);
+      }
+      auto start = steady_clock::now();
+      while (engine->poll(std::chrono::milliseconds{0})) {
+      }
+      elapsed += duration_cast<nanoseconds>(steady_clock::now() - start);
+   }
+
+   for (int fd : s.fds) {
+      counter_handle h{fd};
+      engine->stop_monitoring(h);
+   }
+
+   long checksum = 0;
+   for (const auto &object : s.objects) {
+      checksum += object.count;
+   }
+   std::printf("%-10s fds=%-7zu ns/event=%-7.3f (checksum %ld)\n",
+               name, s.fds.size(), static_cast<double>(elapsed.count()) / static_cast<double>(s.fds.size() * rounds),
+               checksum);
+}
+
+}
+
+
+int main(int argc, char **argv) {
+   std::size_t descriptors = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 8192;
+   std::size_t spread = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 64;
+   std::size_t rounds = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 200;
+
+   setup s;
+   s.objects.resize(descriptors * spread);
+   for (std::size_t i = 0U; i < descriptors; ++i) {
+      int fd = ::eventfd(0U, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (fd < 0) {
+         std::perror("eventfd");
+         return 1;
+      }
+      s.fds.push_back(fd);
+      s.placement.push_back(i * spread);
+   }
+   std::shuffle(s.placement.begin(), s.placement.end(), std::mt19937{42U});
+
+   run("in-order", s, 0U, false, rounds);
+   run("prefetch", s, 8U, false, rounds);
+   run("grouped", s, 8U, true, rounds);
+
+   for (int fd : s.fds) {
+      ::close(fd);
+   }
+   return 0;
+}
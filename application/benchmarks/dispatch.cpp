@@ -0,0 +1,111 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Cost of dispatching a batch of ready events to their handlers, without the kernel.  Activations for a few
+// handler types are shuffled into one array, as a poll returning many ready descriptors would present them.
+#include "activation.h"
+#include "epoll_service.h"
+#include "static_activation.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+
+template<int N>
+struct counting_handler {
+   void on_activation(mode flags) {
+      count += static_cast<int>(flags) + N;
+   }
+
+   long count = 0;
+};
+
+
+using handler_0 = counting_handler<0>;
+using handler_1 = counting_handler<1>;
+using handler_2 = counting_handler<2>;
+using handler_3 = counting_handler<3>;
+
+using static_activation = basic_static_activation<void(mode),
+                                                  event_handler<handler_0, &handler_0::on_activation>,
+                                                  event_handler<handler_1, &handler_1::on_activation>,
+                                                  event_handler<handler_2, &handler_2::on_activation>,
+                                                  event_handler<handler_3, &handler_3::on_activation>>;
+
+
+struct handlers {
+   std::vector<handler_0> h0;
+   std::vector<handler_1> h1;
+   std::vector<handler_2> h2;
+   std::vector<handler_3> h3;
+
+   explicit handlers(std::size_t n) :
+      h0(n / 4 + 1), h1(n / 4 + 1), h2(n / 4 + 1), h3(n / 4 + 1)
+   {
+   }
+
+   long total() const {
+      long result = 0;
+      for (std::size_t i = 0; i < h0.size(); ++i) {
+         result += h0[i].count + h1[i].count + h2[i].count + h3[i].count;
+      }
+      return result;
+   }
+};
+
+
+template<class Activation>
+std::vector<Activation> create_activations(handlers &objects, std::size_t n, unsigned seed) {
+   std::vector<Activation> result;
+   result.reserve(n);
+   for (std::size_t i = 0; i < n; ++i) {
+      switch (i % 4) {
+         case 0: result.push_back(Activation::template create<handler_0, &handler_0::on_activation>(objects.h0[i / 4])); break;
+         case 1: result.push_back(Activation::template create<handler_1, &handler_1::on_activation>(objects.h1[i / 4])); break;
+         case 2: result.push_back(Activation::template create<handler_2, &handler_2::on_activation>(objects.h2[i / 4])); break;
+         default: result.push_back(Activation::template create<handler_3, &handler_3::on_activation>(objects.h3[i / 4])); break;
+      }
+   }
+   std::shuffle(result.begin(), result.end(), std::mt19937{seed});
+   return result;
+}
+
+
+template<class Activation>
+void run(const char *name, std::size_t ready, std::size_t rounds) {
+   handlers objects{ready};
+   auto activations = create_activations<Activation>(objects, ready, 42U);
+
+   auto start = steady_clock::now();
+   for (std::size_t round = 0; round < rounds; ++round) {
+      for (auto &activation : activations) {
+         activation.execute(mode::read);
+      }
+   }
+   auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+   double events = static_cast<double>(ready * rounds);
+   std::printf("%-10s ready=%-7zu events=%-12.0f ns/event=%-7.3f (checksum %ld)\n",
+               name, ready, events, static_cast<double>(elapsed.count()) / events, objects.total());
+}
+
+}
+
+
+int main(int argc, char **argv) {
+   std::size_t ready = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4096;
+   std::size_t rounds = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 2000;
+
+   run<event_activation>("indirect", ready, rounds);
+   run<static_activation>("static", ready, rounds);
+   return 0;
+}
@@ -0,0 +1,62 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Throughput of splitting a receive buffer of text lines with each delimiter scan the CPU supports.
+#include "framing.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace {
+
+using namespace epolling;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+
+std::string create_lines(std::size_t size, std::size_t mean_line_length) {
+   std::mt19937 random{42U};
+   std::uniform_int_distribution<std::size_t> length(1U, 2U * mean_line_length);
+   std::string result;
+   result.reserve(size + 2U * mean_line_length);
+   while (result.size() < size) {
+      result.append(length(random), 'x');
+      result += '\n';
+   }
+   return result;
+}
+
+
+void run(const char *name, details_::find_byte_type find, const std::string &data, std::size_t rounds) {
+   std::size_t lines = 0U;
+   auto start = steady_clock::now();
+   for (std::size_t round = 0; round < rounds; ++round) {
+      for (std::size_t offset = 0U; offset < data.size(); ++lines) {
+         offset += find(data.data() + offset, data.size() - offset, '\n') + 1U;
+      }
+   }
+   auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+   double bytes = static_cast<double>(data.size() * rounds);
+   std::printf("%-7s lines=%-10zu GB/s=%-7.3f\n", name, lines, bytes / static_cast<double>(elapsed.count()));
+}
+
+}
+
+
+int main(int argc, char **argv) {
+   std::size_t mean_line_length = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 80;
+   std::size_t rounds = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+   auto data = create_lines(1U << 20U, mean_line_length);
+   run("scalar", &details_::find_byte_scalar, data, rounds);
+#if defined(__SSE2__)
+   run("sse2", &details_::find_byte_sse2, data, rounds);
+   if (__builtin_cpu_supports("avx2")) {
+      run("avx2", &details_::find_byte_avx2, data, rounds);
+   }
+#endif
+   return 0;
+}
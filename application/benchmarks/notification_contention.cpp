@@ -0,0 +1,85 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Many producer threads signalling one engine through a single notification.  The semaphore behavior writes
+// the event file descriptor on every set() (what every notification used to do); the conditional behavior only
+// writes when no wakeup is already pending.  Write system calls are taken from /proc/self/io, which counts them
+// for the whole process.
+#include "epoll_service.h"
+#include "event_engine.h"
+#include "notification.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+
+unsigned long long write_syscalls() {
+   std::ifstream io{"/proc/self/io"};
+   std::string key;
+   unsigned long long value = 0;
+   while (io >> key >> value) {
+      if (key == "syscw:") {
+         return value;
+      }
+   }
+   return 0;
+}
+
+
+void run(const char *name, notification::behavior how_to_behave, std::size_t producers, std::size_t signals) {
+   auto engine = std::make_shared<event_engine<epoll_service>>(64);
+   notification target{*engine, how_to_behave, 0};
+   auto loop = std::async(std::launch::async, [&engine] { return engine->run(); });
+   while (!engine->running()) {
+      std::this_thread::yield();
+   }
+
+   std::vector<std::thread> threads;
+   threads.reserve(producers);
+   unsigned long long writes_before = write_syscalls();
+   auto start = steady_clock::now();
+   for (std::size_t i = 0; i < producers; ++i) {
+      threads.emplace_back([&target, signals] {
+            for (std::size_t j = 0; j < signals; ++j) {
+               target.set(1);
+            }
+         });
+   }
+   for (auto &t : threads) {
+      t.join();
+   }
+   auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+   unsigned long long writes = write_syscalls() - writes_before;
+
+   engine->quit();
+   (void)loop.get();
+
+   double total = static_cast<double>(producers * signals);
+   std::printf("%-12s producers=%-3zu signals=%-10.0f writes=%-10llu writes/signal=%-8.4f ns/signal=%.1f\n",
+               name, producers, total, writes, static_cast<double>(writes) / total,
+               static_cast<double>(elapsed.count()) / total);
+}
+
+}
+
+
+int main(int argc, char **argv) {
+   std::size_t producers = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+   std::size_t signals = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 100000;
+
+   run("semaphore", notification::behavior::semaphore, producers, signals);
+   run("conditional", notification::behavior::conditional, producers, signals);
+   return 0;
+}
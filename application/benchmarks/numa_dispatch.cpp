@@ -0,0 +1,81 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Cost of dispatching to activations and connection state that live on another NUMA node, against the same on
+// the dispatching thread's own node.  The working set is sized well past the last level cache so that most
+// dispatches go to memory.  On a machine with a single node both runs are local.
+#include "activation.h"
+#include "epoll_service.h"
+#include "numa.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+
+// Stands in for per-connection state: a cache line that each event reads and writes.
+struct alignas(64) connection {
+   void on_activation(mode flags) {
+      count += static_cast<long>(flags);
+   }
+
+   long count = 0;
+};
+
+
+void run(const char *name, int node, std::size_t connections, std::size_t rounds) {
+   std::vector<connection, numa_allocator<connection>> objects(connections, connection{}, numa_allocator<connection>{node});
+   std::vector<event_activation, numa_allocator<event_activation>> activations{numa_allocator<event_activation>{node}};
+   activations.reserve(connections);
+   for (auto &object : objects) {
+      activations.push_back(event_activation::create<connection, &connection::on_activation>(object));
+   }
+   std::shuffle(activations.begin(), activations.end(), std::mt19937{42U});
+
+   auto start = steady_clock::now();
+   for (std::size_t round = 0; round < rounds; ++round) {
+      for (auto &activation : activations) {
+         activation.execute(mode::read);
+      }
+   }
+   auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+   long checksum = 0;
+   for (auto &object : objects) {
+      checksum += object.count;
+   }
+   double events = static_cast<double>(connections * rounds);
+   std::printf("%-7s node=%-3d connections=%-9zu ns/event=%-7.3f (checksum %ld)\n",
+               name, node, connections, static_cast<double>(elapsed.count()) / events, checksum);
+}
+
+}
+
+
+int main(int argc, char **argv) {
+   std::size_t connections = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1U << 20U;
+   std::size_t rounds = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 20;
+
+   int local = 0;
+   int remote = (numa_node_count() > 1) ? 1 : 0;
+   auto error = bind_to_numa_node(local);
+   if (error) {
+      std::fprintf(stderr, "Failed to bind to node %d: %s\n", local, error.message().c_str());
+      return 1;
+   }
+   if (remote == local) {
+      std::printf("Single NUMA node; both runs are node local.\n");
+   }
+
+   run("local", local, connections, rounds);
+   run("remote", remote, connections, rounds);
+   return 0;
+}
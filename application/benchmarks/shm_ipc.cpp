@@ -0,0 +1,154 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Cost per message of streaming small messages from a child process to its parent, through a shm_channel and
+// through a loopback TCP connection.  The child sends as fast as it can, a send() per message over TCP, retrying
+// when the channel is full; the parent receives with an engine until it has everything.  Timed from when the
+// parent is first woken to when it has received the last message.
+//
+// Usage: shm_ipc [messages [message size]]
+#include "shm_channel.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+typedef event_engine<epoll_service> engine_type;
+typedef shm_channel<engine_type> channel_type;
+
+struct stream_tag {};
+
+typedef handle<stream_tag, int, -1> stream_handle;
+
+
+struct receiver {
+   void on_message(const char *message, std::size_t size, std::error_code error) {
+      (void)message;
+      (void)error;
+      ++messages;
+      bytes += size;
+   }
+
+   void on_readable(mode flags) {
+      (void)flags;
+      char buffer[64 * 1024];
+      ssize_t n = 0;
+      while ((n = ::read(socket, buffer, sizeof(buffer))) > 0) {
+         bytes += static_cast<std::size_t>(n);
+      }
+   }
+
+   int socket = -1;
+   std::size_t messages = 0U;
+   std::size_t bytes = 0U;
+};
+
+
+void report(const char *name, std::size_t messages, nanoseconds elapsed) {
+   std::printf("%-12s messages=%-9zu ns/message=%.1f\n", name, messages,
+               static_cast<double>(elapsed.count()) / static_cast<double>(messages));
+}
+
+
+void run_shm(std::size_t messages, std::size_t size) {
+   auto engine = std::make_shared<engine_type>(10);
+   receiver r;
+   channel_type channel(*engine, 1U << 20U, channel_type::create_listener<receiver, &receiver::on_message>(r));
+
+   pid_t child = ::fork();
+   if (child == 0) {
+      auto child_engine = std::make_shared<engine_type>(10);
+      receiver unused;
+      channel_type peer(*child_engine, channel.handles(), channel_type::create_listener<receiver, &receiver::on_message>(unused));
+      std::vector<char> message(size, 'x');
+      for (std::size_t i = 0U; i < messages; ++i) {
+         while (!peer.try_send(message.data(), message.size())) {
+            (void)::sched_yield();
+         }
+      }
+      ::_exit(0);
+   }
+
+   (void)engine->poll(std::chrono::seconds{10});
+   auto start = steady_clock::now();
+   while (r.messages < messages) {
+      (void)engine->poll(std::chrono::seconds{10});
+   }
+   report("shm_channel", messages, duration_cast<nanoseconds>(steady_clock::now() - start));
+   (void)::waitpid(child, nullptr, 0);
+}
+
+
+void run_tcp(std::size_t messages, std::size_t size) {
+   int listening = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   sockaddr_in address{};
+   address.sin_family = AF_INET;
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   socklen_t length = sizeof(address);
+   if ((::bind(listening, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) ||
+       (::listen(listening, 1) != 0) ||
+       (::getsockname(listening, reinterpret_cast<sockaddr *>(&address), &length) != 0)) {
+      std::perror("listener");
+      std::exit(1);
+   }
+
+   pid_t child = ::fork();
+   if (child == 0) {
+      int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      int enabled = 1;
+      (void)::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+      if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+         ::_exit(1);
+      }
+      std::vector<char> message(size, 'x');
+      for (std::size_t i = 0U; i < messages; ++i) {
+         (void)::send(fd, message.data(), message.size(), MSG_NOSIGNAL);
+      }
+      ::_exit(0);
+   }
+
+   receiver r;
+   r.socket = ::accept4(listening, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+   auto engine = std::make_shared<engine_type>(10);
+   engine->start_monitoring<receiver, &receiver::on_readable>(stream_handle{r.socket}, mode::read, r);
+   (void)engine->poll(std::chrono::seconds{10});
+   auto start = steady_clock::now();
+   while (r.bytes < messages * size) {
+      (void)engine->poll(std::chrono::seconds{10});
+   }
+   report("loopback_tcp", messages, duration_cast<nanoseconds>(steady_clock::now() - start));
+   (void)::waitpid(child, nullptr, 0);
+   stream_handle h{r.socket};
+   engine->stop_monitoring(h);
+   (void)::close(r.socket);
+   (void)::close(listening);
+}
+
+}
+
+
+int main(int argc, char **argv) {
+   std::size_t messages = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+   std::size_t size = std::max<std::size_t>((argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 64, 1U);
+
+   run_shm(messages, size);
+   run_tcp(messages, size);
+   return 0;
+}
@@ -0,0 +1,63 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Cost of the engine's loop and dispatch per event, without the kernel: a synthetic_service feeds full batches
+// of made-up readiness to counting handlers for a while.
+#include "synthetic_service.h"
+#include "event_engine.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+struct synthetic_tag {};
+
+constexpr native_handle_type first_handle = 1 << 20;
+
+
+struct counting_handler {
+   void on_activation(mode flags) {
+      count += static_cast<long>(flags);
+   }
+
+   long count = 0;
+};
+
+}
+
+
+int main(int argc, char **argv) {
+   std::size_t handles = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000;
+   std::size_t batch = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 64;
+   long milliseconds = (argc > 3) ? std::strtol(argv[3], nullptr, 10) : 2000;
+
+   auto engine = std::make_shared<event_engine<synthetic_service>>(batch);
+   auto &service = std::experimental::use_service<synthetic_service>(*engine);
+   service.set_load({first_handle, handles, batch, 0.0, 6U, 2U, 1U, 1U, 0U, 0.0, 42U});
+
+   std::vector<counting_handler> handlers(handles);
+   for (std::size_t i = 0U; i < handles; ++i) {
+      engine->start_monitoring<counting_handler, &counting_handler::on_activation>(
+            handle<synthetic_tag, int, -1>{first_handle + static_cast<int>(i)}, mode::read_write, handlers[i]);
+   }
+
+   auto start = steady_clock::now();
+   (void)engine->run(std::chrono::milliseconds{milliseconds});
+   auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+   long checksum = 0;
+   for (const auto &h : handlers) {
+      checksum += h.count;
+   }
+   double events = static_cast<double>(service.events_delivered());
+   std::printf("handles=%-8zu batch=%-5zu events=%-12.0f ns/event=%-7.3f (checksum %ld)\n",
+               handles, batch, events, static_cast<double>(elapsed.count()) / events, checksum);
+   return 0;
+}
@@ -0,0 +1,287 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Echoes back whatever its clients send, on one engine per thread.  Every thread has a listening socket of its
+// own on the same port (SO_REUSEPORT), which the kernel spreads connections across; connections stay on the
+// thread that accepted them.
+//
+// Usage: echo_server [port [threads [accept batch]]]
+#include "async_acceptor.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include "write_queue.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+
+typedef event_engine<epoll_service> engine_type;
+typedef async_acceptor<engine_type> acceptor_type;
+typedef write_queue<engine_type> queue_type;
+
+struct connection_tag {};
+
+typedef handle<connection_tag, int, -1> connection_handle;
+
+constexpr std::size_t read_size = 16U * 1024U;
+constexpr std::size_t low_watermark = 64U * 1024U;
+constexpr std::size_t high_watermark = 256U * 1024U;
+
+
+class server;
+
+
+// Reads until the socket runs dry, queues everything read to be sent back and flushes it.  A client that does not
+// keep up with its echoes is not read from until it does.
+class connection final {
+   friend class server;
+
+public:
+   connection(server &s, engine_type &e, int fd);
+   connection() = delete;
+   connection(const connection &) = delete;
+   connection & operator =(const connection &) = delete;
+
+   ~connection() noexcept {
+      connection_handle h{socket};
+      engine.stop_monitoring(h);
+      (void)::close(socket);
+   }
+
+private:
+   void on_activation(mode flags);
+   void on_backpressure(queue_type::backpressure b);
+
+   // False once the connection is finished with.
+   bool receive();
+
+   server &owner;
+   engine_type &engine;
+   int socket;
+   bool paused;
+   bool drained;
+   queue_type queue;
+};
+
+
+// Connections accepted together are registered together.  Out of descriptors, a reserve one is given up to
+// accept and close whatever is waiting, so that the listening socket does not stay ready for ever and its clients
+// are turned away rather than left hanging.
+class server final {
+public:
+   server(engine_type &e, int listening_socket, std::size_t batch) :
+      engine(e),
+      listening(listening_socket),
+      reserve(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      connections(),
+      accepted(),
+      acceptor(e, listening_socket, batch, acceptor_type::create_listener<server, &server::on_accept>(*this))
+   {
+      accepted.reserve(batch);
+   }
+
+   server() = delete;
+   server(const server &) = delete;
+   server & operator =(const server &) = delete;
+
+   ~server() noexcept {
+      (void)::close(reserve);
+   }
+
+   // Deferred until the end of the activation that asked for it, which still runs on the connection.
+   inline void close(int fd) {
+      closing.push_back(fd);
+   }
+
+   inline void reap() {
+      for (int fd : closing) {
+         connections[static_cast<std::size_t>(fd)].reset();
+      }
+      closing.clear();
+   }
+
+private:
+   void on_accept(acceptor_type::batch_type &batch, std::error_code error) {
+      accepted.clear();
+      for (int fd : batch) {
+         int enabled = 1;
+         (void)::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+         if (connections.size() <= static_cast<std::size_t>(fd)) {
+            connections.resize(static_cast<std::size_t>(fd) + 1U);
+         }
+         connections[static_cast<std::size_t>(fd)] = std::make_unique<connection>(*this, engine, fd);
+         accepted.emplace_back(connection_handle{fd}, connections[static_cast<std::size_t>(fd)].get());
+      }
+      engine.start_monitoring<connection, &connection::on_activation>(accepted.begin(), accepted.end(), mode::read);
+
+      if (error) {
+         if ((error == std::errc::too_many_files_open) || (error == std::errc::too_many_files_open_in_system)) {
+            shed();
+         }
+         else {
+            std::fprintf(stderr, "accept: %s\n", error.message().c_str());
+         }
+         acceptor.resume();
+      }
+   }
+
+   void shed() {
+      std::size_t turned_away = 0U;
+      for (;;) {
+         (void)::close(reserve);
+         int fd = ::accept4(listening, nullptr, nullptr, SOCK_CLOEXEC);
+         int error = errno;
+         if (fd >= 0) {
+            (void)::close(fd);
+            ++turned_away;
+         }
+         reserve = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+         if ((fd < 0) && (error != EINTR) && (error != ECONNABORTED)) {
+            break;
+         }
+      }
+      std::fprintf(stderr, "accept: out of descriptors, turned away %zu connections\n", turned_away);
+   }
+
+   engine_type &engine;
+   int listening;
+   int reserve;
+   std::vector<std::unique_ptr<connection>> connections;
+   std::vector<std::pair<connection_handle, connection *>> accepted;
+   std::vector<int> closing;
+   acceptor_type acceptor;
+};
+
+
+connection::connection(server &s, engine_type &e, int fd) :
+   owner(s),
+   engine(e),
+   socket(fd),
+   paused(false),
+   drained(false),
+   queue(e, fd, mode::read, low_watermark, high_watermark,
+         queue_type::create_listener<connection, &connection::on_backpressure>(*this))
+{
+}
+
+
+void connection::on_activation(mode flags) {
+   bool open = ((flags & mode::error) == mode::none);
+   if ((flags & (mode::read | mode::hangup)) != mode::none) {
+      drained = false;
+   }
+   if (open && ((flags & mode::write) != mode::none)) {
+      open = !queue.on_writable();
+   }
+   // Draining the queue may lift a pause after the socket has stopped raising edges for what is left in it.
+   while (open && !paused && !drained) {
+      open = receive() && !queue.flush();
+   }
+   if (open && paused) {
+      open = !queue.flush();
+   }
+   if (!open) {
+      owner.close(socket);
+   }
+   owner.reap();
+}
+
+
+void connection::on_backpressure(queue_type::backpressure b) {
+   paused = (b == queue_type::backpressure::pause);
+}
+
+
+bool connection::receive() {
+   char buffer[read_size];
+   while (!paused) {
+      ssize_t received = ::read(socket, buffer, sizeof(buffer));
+      if (received > 0) {
+         queue.enqueue(buffer, static_cast<std::size_t>(received));
+      }
+      else if (received == 0) {
+         return false;
+      }
+      else if (errno != EINTR) {
+         drained = true;
+         return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+      }
+   }
+   return true;
+}
+
+
+int create_listener(unsigned short port) {
+   int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   int enabled = 1;
+   sockaddr_in address{};
+   address.sin_family = AF_INET;
+   address.sin_addr.s_addr = htonl(INADDR_ANY);
+   address.sin_port = htons(port);
+   if ((fd < 0) ||
+       (::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) != 0) ||
+       (::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enabled, sizeof(enabled)) != 0) ||
+       (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) ||
+       (::listen(fd, SOMAXCONN) != 0)) {
+      std::perror("listener");
+      std::exit(1);
+   }
+   return fd;
+}
+
+
+void serve(unsigned short port, std::size_t batch) {
+   int listening = create_listener(port);
+   auto engine = std::make_shared<engine_type>(256);
+   server s{*engine, listening, batch};
+   auto error = engine->run();
+   if (error) {
+      std::fprintf(stderr, "engine: %s\n", error.message().c_str());
+   }
+}
+
+
+// Tens of thousands of connections need more descriptors than the usual soft limit.
+void raise_descriptor_limit() {
+   ::rlimit limit{};
+   if (::getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+      limit.rlim_cur = limit.rlim_max;
+      (void)::setrlimit(RLIMIT_NOFILE, &limit);
+   }
+}
+
+}
+
+
+int main(int argc, char **argv) {
+   auto port = static_cast<unsigned short>((argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 7777);
+   std::size_t threads = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 1;
+   std::size_t batch = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 64;
+
+   raise_descriptor_limit();
+   std::printf("Echoing on port %u with %zu threads.\n", static_cast<unsigned>(port), threads);
+   std::fflush(stdout);
+
+   std::vector<std::thread> workers;
+   for (std::size_t i = 1U; i < threads; ++i) {
+      workers.emplace_back(serve, port, batch);
+   }
+   serve(port, batch);
+   for (auto &worker : workers) {
+      worker.join();
+   }
+   return 0;
+}
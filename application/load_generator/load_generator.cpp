@@ -0,0 +1,268 @@
+// vim: sw=3 ts=3 expandtab cindent
+//
+// Drives an echo server with many concurrent connections spread over a few threads, each running an engine of its
+// own.  Every connection keeps one request of a fixed size in flight, sending the next as soon as the whole echo
+// of the last one is back, and the time from send to complete echo is that request's latency.  After a warm up
+// second, requests completed and their latencies are counted for the given duration; the report gives the
+// request rate and latency percentiles over all threads.
+//
+// Usage: load_generator [address [port [connections [threads [seconds [request size]]]]]]
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+typedef event_engine<epoll_service> engine_type;
+
+struct client_tag {};
+
+typedef handle<client_tag, int, -1> client_handle;
+
+
+struct settings {
+   sockaddr_in address;
+   std::size_t connections;
+   std::size_t threads;
+   std::chrono::seconds duration;
+   std::size_t request_size;
+};
+
+
+// What a thread measured: the latency of every request that completed in the measured window.
+struct results {
+   std::vector<std::uint64_t> latencies;
+   std::size_t failures = 0U;
+};
+
+
+class client final {
+public:
+   // measure_from is read on completion only, so it may be set after every client has been created.
+   client(engine_type &e, const settings &s, results &r, const steady_clock::time_point &measure_from) :
+      engine(e),
+      out(s.request_size, 'x'),
+      in(s.request_size),
+      measured(r),
+      measure_start(measure_from),
+      sent(0U),
+      received(0U),
+      request_start(),
+      socket(::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0))
+   {
+      int enabled = 1;
+      if ((socket < 0) ||
+          (::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled)) != 0) ||
+          ((::connect(socket, reinterpret_cast<const sockaddr *>(&s.address), sizeof(s.address)) != 0) && (errno != EINPROGRESS))) {
+         fail();
+         return;
+      }
+      engine.start_monitoring<client, &client::on_activation>(client_handle{socket}, mode::read_write, *this);
+   }
+
+   client() = delete;
+   client(const client &) = delete;
+   client & operator =(const client &) = delete;
+
+   ~client() noexcept {
+      close();
+   }
+
+private:
+   void on_activation(mode flags) {
+      if ((flags & (mode::error | mode::hangup)) != mode::none) {
+         fail();
+         return;
+      }
+      if (((flags & mode::write) != mode::none) && (sent < out.size())) {
+         send();
+      }
+      if ((flags & mode::read) != mode::none) {
+         receive();
+      }
+   }
+
+   void send() {
+      if (sent == 0U) {
+         request_start = steady_clock::now();
+      }
+      while (sent < out.size()) {
+         ssize_t result = ::send(socket, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+         if (result > 0) {
+            sent += static_cast<std::size_t>(result);
+         }
+         else if ((errno != EINTR) && (errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            fail();
+            return;
+         }
+         else if (errno != EINTR) {
+            return;
+         }
+      }
+   }
+
+   void receive() {
+      for (;;) {
+         ssize_t result = ::read(socket, in.data() + received, in.size() - received);
+         if (result > 0) {
+            received += static_cast<std::size_t>(result);
+            if (received == in.size()) {
+               complete();
+               if (socket < 0) {
+                  return;
+               }
+            }
+         }
+         else if ((result == 0) || ((errno != EINTR) && (errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+            fail();
+            return;
+         }
+         else if (errno != EINTR) {
+            return;
+         }
+      }
+   }
+
+   void complete() {
+      auto now = steady_clock::now();
+      if (request_start >= measure_start) {
+         measured.latencies.push_back(static_cast<std::uint64_t>(duration_cast<nanoseconds>(now - request_start).count()));
+      }
+      sent = 0U;
+      received = 0U;
+      send();
+   }
+
+   void fail() {
+      ++measured.failures;
+      close();
+   }
+
+   void close() {
+      if (socket >= 0) {
+         client_handle h{socket};
+         engine.stop_monitoring(h);
+         (void)::close(socket);
+         socket = -1;
+      }
+   }
+
+   engine_type &engine;
+   std::vector<char> out;
+   std::vector<char> in;
+   results &measured;
+   const steady_clock::time_point &measure_start;
+   std::size_t sent;
+   std::size_t received;
+   steady_clock::time_point request_start;
+   int socket;
+};
+
+
+void generate(const settings &s, std::size_t connections, results &r) {
+   auto engine = std::make_shared<engine_type>(256);
+   steady_clock::time_point measure_start = steady_clock::time_point::max();
+   std::vector<std::unique_ptr<client>> clients;
+   clients.reserve(connections);
+   for (std::size_t i = 0U; i < connections; ++i) {
+      clients.push_back(std::make_unique<client>(*engine, s, r, measure_start));
+   }
+   r.latencies.reserve(1U << 20U);
+
+   // Only now, as creating and connecting thousands of clients can take longer than the warm up.
+   measure_start = steady_clock::now() + std::chrono::seconds{1};
+
+   // Warm up, then measure.  A negative timeout would run for ever.
+   auto warm_up = duration_cast<nanoseconds>(measure_start - steady_clock::now());
+   if (warm_up > nanoseconds{0}) {
+      (void)engine->run(warm_up);
+   }
+   (void)engine->run(s.duration);
+}
+
+
+std::uint64_t percentile(std::vector<std::uint64_t> &latencies, double fraction) {
+   if (latencies.empty()) {
+      return 0U;
+   }
+   auto index = static_cast<std::size_t>(fraction * static_cast<double>(latencies.size() - 1U));
+   std::nth_element(latencies.begin(), latencies.begin() + static_cast<std::ptrdiff_t>(index), latencies.end());
+   return latencies[index];
+}
+
+
+void raise_descriptor_limit() {
+   ::rlimit limit{};
+   if (::getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+      limit.rlim_cur = limit.rlim_max;
+      (void)::setrlimit(RLIMIT_NOFILE, &limit);
+   }
+}
+
+}
+
+
+int main(int argc, char **argv) {
+   settings s{};
+   s.address.sin_family = AF_INET;
+   if (::inet_pton(AF_INET, (argc > 1) ? argv[1] : "127.0.0.1", &s.address.sin_addr) != 1) {
+      std::fprintf(stderr, "Not an IPv4 address: %s\n", argv[1]);
+      return 1;
+   }
+   s.address.sin_port = htons(static_cast<unsigned short>((argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 7777));
+   s.connections = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 1000;
+   s.threads = std::max<std::size_t>((argc > 4) ? std::strtoul(argv[4], nullptr, 10) : 1, 1U);
+   s.duration = std::chrono::seconds{(argc > 5) ? std::strtol(argv[5], nullptr, 10) : 10};
+   s.request_size = std::max<std::size_t>((argc > 6) ? std::strtoul(argv[6], nullptr, 10) : 64, 1U);
+
+   raise_descriptor_limit();
+
+   std::vector<results> per_thread(s.threads);
+   std::vector<std::thread> workers;
+   for (std::size_t i = 0U; i < s.threads; ++i) {
+      std::size_t share = s.connections / s.threads + ((i < s.connections % s.threads) ? 1U : 0U);
+      workers.emplace_back(generate, std::cref(s), share, std::ref(per_thread[i]));
+   }
+   for (auto &worker : workers) {
+      worker.join();
+   }
+
+   std::vector<std::uint64_t> latencies;
+   std::size_t failures = 0U;
+   for (auto &r : per_thread) {
+      latencies.insert(latencies.end(), r.latencies.begin(), r.latencies.end());
+      failures += r.failures;
+   }
+
+   double seconds = static_cast<double>(s.duration.count());
+   std::size_t requests = latencies.size();
+   std::uint64_t p50 = percentile(latencies, 0.5);
+   std::uint64_t p99 = percentile(latencies, 0.99);
+   std::uint64_t p999 = percentile(latencies, 0.999);
+   std::printf("connections=%-7zu threads=%-3zu size=%-6zu requests=%-10zu req/s=%-10.0f "
+               "p50=%.1fus p99=%.1fus p999=%.1fus failures=%zu\n",
+               s.connections, s.threads, s.request_size, requests, static_cast<double>(requests) / seconds,
+               static_cast<double>(p50) / 1000.0, static_cast<double>(p99) / 1000.0, static_cast<double>(p999) / 1000.0,
+               failures);
+   return (failures == s.connections) ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "activation.h"
+#include "inline_activation.h"
+#include "static_activation.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace epolling;
+
+
+struct first_handler {
+   void on_activation(int value) {
+      received = value;
+   }
+
+   int received = 0;
+};
+
+
+struct second_handler {
+   void on_activation(int value) {
+      received = -value;
+   }
+
+   int received = 0;
+};
+
+
+struct derived_handler : std::string, second_handler {
+};
+
+
+typedef activation_handler<first_handler, void (first_handler::*)(int), &first_handler::on_activation> first_type;
+typedef activation_handler<second_handler, void (second_handler::*)(int), &second_handler::on_activation> second_type;
+typedef basic_static_activation<void(int), first_type, second_type> static_activation_type;
+
+
+TEST(basic_activation, execute_given_member_activation_should_invoke_member_on_object) {
+   // Given
+   first_handler object;
+   auto target = basic_activation<void(int)>::create<first_handler, &first_handler::on_activation>(object);
+
+   // When
+   target.execute(42);
+
+   // Then
+   ASSERT_EQ(42, object.received);
+}
+
+
+TEST(basic_inline_activation, execute_given_lambda_should_invoke_copy_held_inline) {
+   // Given
+   int received = 0;
+   auto target = basic_inline_activation<void(int)>::create([&received](int value) { received = value * 2; });
+   auto copy = target;
+
+   // When
+   copy.execute(21);
+
+   // Then
+   ASSERT_EQ(42, received);
+}
+
+
+TEST(basic_inline_activation, execute_given_member_activation_should_invoke_member_on_object) {
+   // Given
+   first_handler object;
+   auto target = basic_inline_activation<void(int)>::create<first_handler, &first_handler::on_activation>(object);
+
+   // When
+   target.execute(42);
+
+   // Then
+   ASSERT_EQ(42, object.received);
+}
+
+
+TEST(basic_static_activation, create_should_tag_with_position_in_handler_set) {
+   // Given
+   first_handler first;
+   second_handler second;
+
+   // When
+   auto first_target = static_activation_type::create<first_handler, &first_handler::on_activation>(first);
+   auto second_target = static_activation_type::create<second_handler, &second_handler::on_activation>(second);
+
+   // Then
+   ASSERT_EQ(0U, first_target.tag);
+   ASSERT_EQ(1U, second_target.tag);
+}
+
+
+TEST(basic_static_activation, execute_should_invoke_handler_selected_by_tag) {
+   // Given
+   first_handler first;
+   second_handler second;
+   auto first_target = static_activation_type::create<first_handler, &first_handler::on_activation>(first);
+   auto second_target = static_activation_type::create<second_handler, &second_handler::on_activation>(second);
+
+   // When
+   first_target.execute(7);
+   second_target.execute(9);
+
+   // Then
+   ASSERT_EQ(7, first.received);
+   ASSERT_EQ(-9, second.received);
+}
+
+
+TEST(basic_static_activation, execute_given_derived_object_should_invoke_handler_on_base) {
+   // Given
+   derived_handler object;
+   auto target = static_activation_type::create<second_handler, &second_handler::on_activation>(object);
+
+   // When
+   target.execute(3);
+
+   // Then
+   ASSERT_EQ(-3, object.received);
+}
+
+}
@@ -0,0 +1,140 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "async_acceptor.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+typedef event_engine<epoll_service> engine_type;
+typedef async_acceptor<engine_type> acceptor_type;
+
+
+struct async_acceptor_tests : ::testing::Test {
+   async_acceptor_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<engine_type>(10)),
+      listening(::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)),
+      address(),
+      batches(0)
+   {
+      socklen_t length = sizeof(address);
+      address.sin_family = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      (void)::bind(listening, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+      (void)::listen(listening, SOMAXCONN);
+      (void)::getsockname(listening, reinterpret_cast<sockaddr *>(&address), &length);
+   }
+
+   virtual ~async_acceptor_tests() override {
+      engine.reset();
+      for (int fd : accepted) {
+         (void)::close(fd);
+      }
+      for (int fd : clients) {
+         (void)::close(fd);
+      }
+      (void)::close(listening);
+   }
+
+   inline std::unique_ptr<acceptor_type> create_target(std::size_t budget) {
+      return std::make_unique<acceptor_type>(*engine, listening, budget,
+                                             acceptor_type::create_listener<async_acceptor_tests, &async_acceptor_tests::on_accept>(*this));
+   }
+
+   inline void connect(std::size_t count) {
+      for (std::size_t i = 0; i < count; ++i) {
+         clients.push_back(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+         ASSERT_EQ(0, ::connect(clients.back(), reinterpret_cast<sockaddr *>(&address), sizeof(address)));
+      }
+   }
+
+   void on_accept(acceptor_type::batch_type &batch, std::error_code error) {
+      ++batches;
+      last_error = error;
+      accepted.insert(accepted.end(), batch.begin(), batch.end());
+   }
+
+   std::shared_ptr<engine_type> engine;
+   int listening;
+   sockaddr_in address;
+   std::vector<int> clients;
+   std::vector<int> accepted;
+   std::size_t batches;
+   std::error_code last_error;
+};
+
+
+TEST_F(async_acceptor_tests, poll_given_pending_connections_should_accept_them_in_one_batch) {
+   // Arrange
+   auto target = create_target(16);
+   connect(3);
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(1U, batches);
+   ASSERT_EQ(3U, accepted.size());
+   ASSERT_EQ(std::error_code{}, last_error);
+}
+
+
+TEST_F(async_acceptor_tests, poll_given_more_connections_than_budget_should_accept_the_rest_next_iteration) {
+   // Arrange
+   auto target = create_target(2);
+   connect(3);
+
+   // Act
+   (void)engine->poll(0ns);
+   std::size_t accepted_first = accepted.size();
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(2U, accepted_first);
+   ASSERT_EQ(3U, accepted.size());
+   ASSERT_EQ(2U, batches);
+}
+
+
+TEST_F(async_acceptor_tests, poll_given_connections_after_a_drained_batch_should_accept_them_on_their_own_edge) {
+   // Arrange
+   auto target = create_target(16);
+   connect(1);
+   (void)engine->poll(0ns);
+
+   // Act
+   bool idle = engine->poll(0ns);
+   connect(2);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_FALSE(idle);
+   ASSERT_EQ(3U, accepted.size());
+   ASSERT_EQ(2U, batches);
+}
+
+
+TEST_F(async_acceptor_tests, accepted_handles_should_be_non_blocking) {
+   // Arrange
+   auto target = create_target(16);
+   connect(1);
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(1U, accepted.size());
+   ASSERT_NE(0, ::fcntl(accepted.front(), F_GETFL) & O_NONBLOCK);
+}
+
+}
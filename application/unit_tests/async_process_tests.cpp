@@ -0,0 +1,125 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "async_process.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+typedef event_engine<epoll_service> engine_type;
+typedef async_process<engine_type> process_type;
+
+
+struct async_process_tests : ::testing::Test {
+   async_process_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<engine_type>(10)),
+      exits(0),
+      last_exit{false, -1},
+      last_error()
+   {
+   }
+
+   inline std::unique_ptr<process_type> create_target(std::vector<std::string> argv) {
+      return std::make_unique<process_type>(*engine, argv,
+                                            process_type::create_listener<async_process_tests, &async_process_tests::on_exit>(*this));
+   }
+
+   inline void wait_for_exit() {
+      for (int i = 0; (i < 500) && (exits == 0); ++i) {
+         (void)engine->poll(10ms);
+      }
+   }
+
+   void on_exit(process_exit exit, std::error_code error) {
+      ++exits;
+      last_exit = exit;
+      last_error = error;
+   }
+
+   std::shared_ptr<engine_type> engine;
+   int exits;
+   process_exit last_exit;
+   std::error_code last_error;
+};
+
+
+TEST_F(async_process_tests, poll_given_exited_child_should_report_exit_status_once) {
+   // Arrange
+   auto target = create_target({"/bin/sh", "-c", "exit 3"});
+
+   // Act
+   wait_for_exit();
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(1, exits);
+   ASSERT_EQ(std::error_code{}, last_error);
+   ASSERT_FALSE(last_exit.signalled);
+   ASSERT_EQ(3, last_exit.status);
+   ASSERT_FALSE(target->running());
+}
+
+
+TEST_F(async_process_tests, kill_should_report_signal_that_ended_child) {
+   // Arrange
+   auto target = create_target({"sleep", "10"});
+
+   // Act
+   auto error = target->kill(SIGTERM);
+   wait_for_exit();
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_EQ(1, exits);
+   ASSERT_TRUE(last_exit.signalled);
+   ASSERT_EQ(SIGTERM, last_exit.status);
+}
+
+
+TEST_F(async_process_tests, output_should_be_readable_without_blocking) {
+   // Arrange
+   auto target = create_target({"/bin/sh", "-c", "echo hello"});
+   wait_for_exit();
+   char buffer[16] = {};
+
+   // Act
+   ssize_t first = ::read(target->output(), buffer, sizeof(buffer));
+   ssize_t second = ::read(target->output(), buffer + first, sizeof(buffer) - static_cast<std::size_t>(first));
+
+   // Assert
+   ASSERT_EQ(6, first);
+   ASSERT_EQ(std::string{"hello\n"}, std::string(buffer, 6));
+   ASSERT_EQ(0, second);
+}
+
+
+TEST_F(async_process_tests, constructor_given_missing_program_should_throw) {
+   // Arrange, Act & Assert
+   ASSERT_THROW(create_target({"/nonexistent/program"}), std::system_error);
+}
+
+
+TEST_F(async_process_tests, destructor_given_running_child_should_not_leave_it_behind) {
+   // Arrange
+   auto target = create_target({"sleep", "10"});
+
+   // Act
+   target.reset();
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(0, exits);
+}
+
+}
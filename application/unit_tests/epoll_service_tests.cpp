@@ -0,0 +1,607 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "epoll_service.h"
+#include "event_engine.h"
+#include "print_to.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <functional>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <time.h>
+#include <typeinfo>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+
+struct testing_tag {};
+
+typedef handle<testing_tag, native_handle_type, -1> testing_handle_type;
+
+
+struct epoll_service_tests : ::testing::Test {
+   epoll_service_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<event_engine<epoll_service>>(10)),
+      fds{-1, -1},
+      activation_flags(mode::none)
+   {
+   }
+
+   virtual ~epoll_service_tests() override {
+      engine.reset();
+      close_local();
+      close_peer();
+   }
+
+   inline void create_socket_pair() {
+      ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds));
+   }
+
+   inline void create_pipe() {
+      int pipe_fds[2] = {-1, -1};
+      ASSERT_EQ(0, ::pipe2(pipe_fds, O_NONBLOCK | O_CLOEXEC));
+      // Monitor the writing end; the reading end plays the peer.
+      fds[0] = pipe_fds[1];
+      fds[1] = pipe_fds[0];
+   }
+
+   inline void monitor(mode flags) {
+      engine->start_monitoring<epoll_service_tests, &epoll_service_tests::on_activation>(testing_handle_type{fds[0]}, flags, *this);
+   }
+
+   inline void close_local() {
+      if (fds[0] != -1) {
+         (void)::close(fds[0]);
+         fds[0] = -1;
+      }
+   }
+
+   inline void close_peer() {
+      if (fds[1] != -1) {
+         (void)::close(fds[1]);
+         fds[1] = -1;
+      }
+   }
+
+   void on_activation(mode flags) {
+      activation_flags = activation_flags | flags;
+   }
+
+   std::shared_ptr<event_engine<epoll_service>> engine;
+   int fds[2];
+   mode activation_flags;
+};
+
+
+TEST_F(epoll_service_tests, poll_when_peer_is_open_should_not_deliver_hangup_or_error) {
+   // Arrange
+   create_socket_pair();
+   monitor(mode::read_write);
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(mode::write, activation_flags & mode::write);
+   ASSERT_EQ(mode::none, activation_flags & (mode::hangup | mode::error));
+}
+
+
+TEST_F(epoll_service_tests, poll_when_peer_closes_should_deliver_hangup) {
+   // Arrange
+   create_socket_pair();
+   monitor(mode::read);
+   close_peer();
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(mode::hangup, activation_flags & mode::hangup);
+}
+
+
+TEST_F(epoll_service_tests, poll_when_pipe_reader_closes_should_deliver_error) {
+   // Arrange
+   create_pipe();
+   monitor(mode::write);
+   close_peer();
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(mode::error, activation_flags & mode::error);
+}
+
+
+
+TEST_F(epoll_service_tests, start_monitoring_given_exclusive_read_should_succeed) {
+   // Arrange
+   create_socket_pair();
+   auto &target = std::experimental::use_service<epoll_service>(*engine);
+
+   // Act
+   auto actual = target.start_monitoring<epoll_service_tests, &epoll_service_tests::on_activation>(testing_handle_type{fds[0]}, mode::read | mode::exclusive, *this);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, actual);
+}
+
+
+TEST_F(epoll_service_tests, update_monitoring_given_exclusive_registration_should_replace_it) {
+   // Arrange
+   create_socket_pair();
+   auto &target = std::experimental::use_service<epoll_service>(*engine);
+   (void)target.start_monitoring<epoll_service_tests, &epoll_service_tests::on_activation>(testing_handle_type{fds[0]}, mode::read | mode::exclusive, *this);
+
+   // Act
+   auto to_exclusive = target.update_monitoring(testing_handle_type{fds[0]}, mode::read_write | mode::exclusive);
+   auto to_shared = target.update_monitoring(testing_handle_type{fds[0]}, mode::read_write);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, to_exclusive);
+   ASSERT_EQ(std::error_code{}, to_shared);
+   ASSERT_EQ(mode::write, activation_flags & mode::write);
+}
+
+
+TEST_F(epoll_service_tests, update_monitoring_when_replaced_entry_cannot_be_added_back_should_drop_registration) {
+   // Arrange
+   // An epoll instance cannot be watched exclusively, which the kernel only finds out when it is added.
+   int nested = ::epoll_create1(EPOLL_CLOEXEC);
+   auto &target = std::experimental::use_service<epoll_service>(*engine);
+   (void)target.start_monitoring<epoll_service_tests, &epoll_service_tests::on_activation>(testing_handle_type{nested}, mode::read, *this);
+
+   // Act
+   auto updated = target.update_monitoring(testing_handle_type{nested}, mode::read | mode::exclusive);
+   auto stopped = target.stop_monitoring(testing_handle_type{nested});
+
+   // Assert
+   ASSERT_EQ(std::make_error_code(std::errc::invalid_argument), updated);
+   ASSERT_EQ(std::make_error_code(std::errc::no_such_file_or_directory), stopped);
+   auto registered = target.snapshot();
+   ASSERT_TRUE(std::none_of(registered.begin(), registered.end(),
+                            [nested](const registration_info &info) { return info.handle == nested; }));
+   (void)::close(nested);
+}
+
+
+TEST_F(epoll_service_tests, stop_monitoring_from_a_handler_should_skip_events_already_in_the_batch) {
+   // Arrange
+   struct stopping_handler {
+      void on_activation(mode flags) {
+         (void)flags;
+         ++activations;
+         engine->stop_monitoring(other->fd);
+      }
+
+      event_engine<epoll_service> *engine;
+      stopping_handler *other;
+      testing_handle_type fd;
+      int activations;
+   };
+   stopping_handler first{engine.get(), nullptr, testing_handle_type{::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC)}, 0};
+   stopping_handler second{engine.get(), &first, testing_handle_type{::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC)}, 0};
+   first.other = &second;
+   int first_fd = first.fd;
+   int second_fd = second.fd;
+   engine->start_monitoring<stopping_handler, &stopping_handler::on_activation>(first.fd, mode::read, first);
+   engine->start_monitoring<stopping_handler, &stopping_handler::on_activation>(second.fd, mode::read, second);
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(1, first.activations + second.activations);
+   engine->stop_monitoring(first.fd);
+   engine->stop_monitoring(second.fd);
+   (void)::close(first_fd);
+   (void)::close(second_fd);
+}
+
+
+TEST_F(epoll_service_tests, poll_with_grouped_dispatch_should_run_each_handler_back_to_back) {
+   // Arrange
+   struct recording_handler {
+      void on_read(mode flags) {
+         (void)flags;
+         order->push_back('r');
+      }
+
+      void on_write(mode flags) {
+         (void)flags;
+         order->push_back('w');
+      }
+
+      std::vector<char> *order;
+   };
+   auto &target = std::experimental::use_service<epoll_service>(*engine);
+   target.set_grouped_dispatch(true);
+   std::vector<char> order;
+   recording_handler handler{&order};
+   std::vector<int> counters;
+   for (int i = 0; i < 6; ++i) {
+      int fd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+      counters.push_back(fd);
+      if (i % 2 == 0) {
+         engine->start_monitoring<recording_handler, &recording_handler::on_read>(testing_handle_type{fd}, mode::read, handler);
+      }
+      else {
+         engine->start_monitoring<recording_handler, &recording_handler::on_write>(testing_handle_type{fd}, mode::read, handler);
+      }
+   }
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(6U, order.size());
+   ASSERT_EQ(3, std::count(order.begin(), order.end(), 'r'));
+   ASSERT_EQ(1, std::inner_product(order.begin() + 1, order.end(), order.begin(), 0, std::plus<int>{},
+                                   [](char a, char b) { return (a != b) ? 1 : 0; }));
+   for (int fd : counters) {
+      testing_handle_type h{fd};
+      engine->stop_monitoring(h);
+      (void)::close(fd);
+   }
+}
+
+
+TEST_F(epoll_service_tests, start_monitoring_after_stop_should_dispatch_to_new_registration_only) {
+   // Arrange
+   struct counting_handler {
+      void on_activation(mode flags) {
+         (void)flags;
+         ++activations;
+      }
+
+      int activations;
+   };
+   create_socket_pair();
+   auto &target = std::experimental::use_service<epoll_service>(*engine);
+   counting_handler old_handler{0};
+   counting_handler new_handler{0};
+   (void)target.start_monitoring<counting_handler, &counting_handler::on_activation>(testing_handle_type{fds[0]}, mode::write, old_handler);
+   (void)target.stop_monitoring(testing_handle_type{fds[0]});
+
+   // Act
+   for (int i = 0; i < 3; ++i) {
+      (void)engine->poll(0ns);
+   }
+   auto actual = target.start_monitoring<counting_handler, &counting_handler::on_activation>(testing_handle_type{fds[0]}, mode::write, new_handler);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, actual);
+   ASSERT_EQ(0, old_handler.activations);
+   ASSERT_EQ(1, new_handler.activations);
+}
+
+
+TEST_F(epoll_service_tests, update_monitoring_given_current_interest_should_not_touch_kernel) {
+   // Arrange
+   struct counting_handler {
+      void on_activation(mode flags) {
+         (void)flags;
+         ++activations;
+      }
+
+      int activations;
+   };
+   counting_handler handler{0};
+   testing_handle_type fd{::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC)};
+   int raw_fd = fd;
+   engine->start_monitoring<counting_handler, &counting_handler::on_activation>(fd, mode::read, handler);
+   (void)engine->poll(0ns);
+
+   // Act
+   // A modification that reaches the kernel re-reports the still readable eventfd.
+   engine->update_monitoring(fd, mode::read);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(1, handler.activations);
+   engine->stop_monitoring(fd);
+   (void)::close(raw_fd);
+}
+
+
+TEST_F(epoll_service_tests, rescan_should_report_a_descriptor_that_is_still_ready_again) {
+   // Arrange
+   struct counting_handler {
+      void on_activation(mode flags) {
+         (void)flags;
+         ++activations;
+      }
+
+      int activations;
+   };
+   counting_handler handler{0};
+   testing_handle_type fd{::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC)};
+   int raw_fd = fd;
+   engine->start_monitoring<counting_handler, &counting_handler::on_activation>(fd, mode::read, handler);
+   (void)engine->poll(0ns);
+   (void)engine->poll(0ns);
+   ASSERT_EQ(1, handler.activations);
+
+   // Act
+   engine->rescan(fd);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(2, handler.activations);
+   engine->stop_monitoring(fd);
+   (void)::close(raw_fd);
+}
+
+
+TEST_F(epoll_service_tests, update_monitoring_given_fired_one_time_registration_should_rearm_it) {
+   // Arrange
+   struct counting_handler {
+      void on_activation(mode flags) {
+         (void)flags;
+         ++activations;
+      }
+
+      int activations;
+   };
+   counting_handler handler{0};
+   testing_handle_type fd{::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC)};
+   int raw_fd = fd;
+   engine->start_monitoring<counting_handler, &counting_handler::on_activation>(fd, mode::read | mode::one_time, handler);
+   (void)engine->poll(0ns);
+   (void)::eventfd_write(raw_fd, 1U);
+   (void)engine->poll(0ns);
+   ASSERT_EQ(1, handler.activations);
+
+   // Act
+   engine->update_monitoring(fd, mode::read | mode::one_time);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(2, handler.activations);
+   engine->stop_monitoring(fd);
+   (void)::close(raw_fd);
+}
+
+
+TEST_F(epoll_service_tests, poll_given_rearmed_one_time_registration_should_rearm_after_handler) {
+   // Arrange
+   struct counting_handler {
+      void on_activation(mode flags) {
+         (void)flags;
+         ++activations;
+      }
+
+      int activations;
+   };
+   counting_handler handler{0};
+   testing_handle_type fd{::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC)};
+   int raw_fd = fd;
+   engine->start_monitoring<counting_handler, &counting_handler::on_activation>(fd, mode::read | mode::one_time | mode::rearm, handler);
+
+   // Act
+   for (int i = 0; i < 3; ++i) {
+      (void)::eventfd_write(raw_fd, 1U);
+      (void)engine->poll(0ns);
+   }
+
+   // Assert
+   ASSERT_EQ(3, handler.activations);
+   engine->stop_monitoring(fd);
+   (void)::close(raw_fd);
+}
+
+
+TEST_F(epoll_service_tests, stop_monitoring_given_unregistered_handle_should_fail) {
+   // Arrange
+   create_socket_pair();
+   auto &target = std::experimental::use_service<epoll_service>(*engine);
+   monitor(mode::read);
+   (void)target.stop_monitoring(testing_handle_type{fds[0]});
+
+   // Act
+   auto actual = target.stop_monitoring(testing_handle_type{fds[0]});
+
+   // Assert
+   ASSERT_EQ(std::make_error_code(std::errc::no_such_file_or_directory), actual);
+}
+
+
+TEST_F(epoll_service_tests, stop_monitoring_from_another_thread_should_not_wait_for_poll) {
+   // Arrange
+   create_socket_pair();
+   monitor(mode::read);
+   auto polling = std::async(std::launch::async, [this] { return engine->poll(2s); });
+   while (!engine->polling()) {
+      std::this_thread::yield();
+   }
+   testing_handle_type fd{fds[0]};
+
+   // Act
+   engine->stop_monitoring(fd);
+   bool still_polling = engine->polling();
+   engine->quit();
+
+   // Assert
+   ASSERT_TRUE(still_polling);
+   ASSERT_FALSE(fd.valid());
+   ASSERT_EQ(std::future_status::ready, polling.wait_for(5s));
+}
+
+
+TEST_F(epoll_service_tests, stop_monitoring_from_another_thread_should_wait_for_the_running_handler) {
+   // Arrange
+   struct slow_handler {
+      void on_activation(mode flags) {
+         (void)flags;
+         started = true;
+         std::this_thread::sleep_for(100ms);
+         finished = true;
+      }
+
+      std::atomic<bool> started;
+      std::atomic<bool> finished;
+   };
+   int counter = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+   testing_handle_type fd{counter};
+   slow_handler handler{{false}, {false}};
+   engine->start_monitoring<slow_handler, &slow_handler::on_activation>(fd, mode::read, handler);
+   auto polling = std::async(std::launch::async, [this] { return engine->poll(5s); });
+   while (!handler.started) {
+      std::this_thread::yield();
+   }
+
+   // Act
+   engine->stop_monitoring(fd);
+
+   // Assert
+   ASSERT_TRUE(handler.finished);
+   ASSERT_EQ(std::future_status::ready, polling.wait_for(5s));
+   (void)::close(counter);
+}
+
+
+TEST_F(epoll_service_tests, stop_monitoring_waiting_for_the_running_handler_should_sleep_rather_than_spin) {
+   // Arrange
+   struct slow_handler {
+      void on_activation(mode flags) {
+         (void)flags;
+         started = true;
+         std::this_thread::sleep_for(200ms);
+      }
+
+      std::atomic<bool> started;
+   };
+   auto cpu_time = [] {
+      ::timespec now{};
+      (void)::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+      return std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec};
+   };
+   int counter = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+   testing_handle_type fd{counter};
+   slow_handler handler{{false}};
+   engine->start_monitoring<slow_handler, &slow_handler::on_activation>(fd, mode::read, handler);
+   auto polling = std::async(std::launch::async, [this] { return engine->poll(5s); });
+   while (!handler.started) {
+      std::this_thread::yield();
+   }
+
+   // Act
+   auto before = cpu_time();
+   engine->stop_monitoring(fd);
+   auto spent = cpu_time() - before;
+
+   // Assert
+   ASSERT_GT(std::chrono::nanoseconds{50ms}, spent);
+   ASSERT_EQ(std::future_status::ready, polling.wait_for(5s));
+   (void)::close(counter);
+}
+
+
+TEST_F(epoll_service_tests, snapshot_from_another_thread_should_report_live_registrations_with_their_activity) {
+   // Arrange
+   create_socket_pair();
+   int idle_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   engine->start_monitoring<epoll_service_tests, &epoll_service_tests::on_activation>(testing_handle_type{idle_fd}, mode::read, *this);
+   monitor(mode::write);
+   auto before = std::chrono::steady_clock::now();
+   (void)engine->poll(0ns);
+
+   // Act
+   auto actual = std::async(std::launch::async, [this] { return engine->snapshot(); }).get();
+
+   // Assert
+   auto find = [&actual](int fd) {
+      return std::find_if(actual.begin(), actual.end(), [fd](const registration_info &info) { return info.handle == fd; });
+   };
+   auto active = find(fds[0]);
+   auto idle = find(idle_fd);
+   ASSERT_NE(actual.end(), active);
+   ASSERT_NE(actual.end(), idle);
+   ASSERT_EQ(mode::write, active->interest);
+   ASSERT_EQ(&typeid(epoll_service_tests), active->handler);
+   ASSERT_EQ(1U, active->activations);
+   ASSERT_LE(before, active->last_activation);
+   ASSERT_EQ(0U, idle->activations);
+   testing_handle_type h{idle_fd};
+   engine->stop_monitoring(h);
+   (void)::close(idle_fd);
+}
+
+
+TEST_F(epoll_service_tests, snapshot_should_leave_out_stopped_registrations) {
+   // Arrange
+   create_socket_pair();
+   monitor(mode::read);
+   testing_handle_type h{fds[0]};
+   engine->stop_monitoring(h);
+
+   // Act
+   auto actual = engine->snapshot();
+
+   // Assert
+   for (const auto &info : actual) {
+      ASSERT_NE(fds[0], info.handle);
+   }
+}
+
+
+TEST(static_epoll_service, poll_should_dispatch_to_handler_in_static_set) {
+   // Arrange
+   struct eventfd_handler {
+      void on_activation(mode flags) {
+         activation_flags = flags;
+      }
+
+      mode activation_flags;
+   };
+   using service_type = static_epoll_service<event_handler<eventfd_handler, &eventfd_handler::on_activation>>;
+   auto engine = std::make_shared<event_engine<service_type>>(10);
+   eventfd_handler handler{mode::none};
+   int fd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+   engine->start_monitoring<eventfd_handler, &eventfd_handler::on_activation>(testing_handle_type{fd}, mode::read, handler);
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(mode::read, handler.activation_flags);
+   engine.reset();
+   (void)::close(fd);
+}
+
+
+
+TEST(inline_epoll_service, poll_should_dispatch_to_registered_lambda) {
+   // Arrange
+   auto engine = std::make_shared<event_engine<inline_epoll_service>>(10);
+   mode activation_flags = mode::none;
+   int fd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+   engine->start_monitoring(testing_handle_type{fd}, mode::read, [&activation_flags](mode flags) { activation_flags = flags; });
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(mode::read, activation_flags);
+   engine.reset();
+   (void)::close(fd);
+}
+
+}
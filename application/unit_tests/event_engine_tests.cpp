@@ -7,6 +7,7 @@
 #include <chrono>
 #include <future>
 #include <memory>
+#include <sys/eventfd.h>
 #include <system_error>
 
 namespace {
@@ -303,6 +304,32 @@ TEST_F(event_engine_tests, run_after_engine_has_been_destructed_should_return_op
 #endif
 
 
+TEST_F(event_engine_tests, run_or_poll_while_another_thread_runs_should_fail_with_device_or_resource_busy) {
+   // Arrange
+   auto target = create_target<epoll_service>();
+   auto running = async(std::launch::async, [&target] { return target->run(5s); });
+   while (!target->polling()) {
+      yield();
+   }
+
+   // Act
+   auto run_error = target->run(0ns);
+   std::error_code poll_error;
+   try {
+      (void)target->poll(0ns);
+   }
+   catch (const std::system_error &e) {
+      poll_error = e.code();
+   }
+   target->quit();
+
+   // Assert
+   ASSERT_EQ(make_error_code(std::errc::device_or_resource_busy), run_error);
+   ASSERT_EQ(make_error_code(std::errc::device_or_resource_busy), poll_error);
+   ASSERT_EQ(std::error_code{}, running.get());
+}
+
+
 TEST_F(event_engine_tests, running_after_calling_run_should_return_true) {
    // Arrange
    std::error_code expected = make_error_code(static_cast<std::errc>((rand() % 4) + 1));
@@ -392,4 +419,52 @@ TEST_F(event_engine_tests, stop_monitoring_given_valid_handle_and_flags_should_r
    ASSERT_FALSE(fd.valid());
 }
 
+
+
+TEST_F(event_engine_tests, update_monitoring_from_a_handler_should_not_wait_for_the_polling_thread) {
+   // Arrange
+   struct rearming_handler {
+      void on_activation(mode flags) {
+         (void)flags;
+         engine->update_monitoring(fd, mode::read);
+         rearmed = true;
+      }
+
+      event_engine<epoll_service> *engine;
+      handle<testing_tag, int, -1> fd;
+      bool rearmed;
+   };
+   auto target = create_target<epoll_service>();
+   int fd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+   rearming_handler handler{target.get(), fd, false};
+   target->start_monitoring<rearming_handler, &rearming_handler::on_activation>(handler.fd, mode::read, handler);
+
+   // Act
+   auto polled = async(std::launch::async, [&target] { return target->poll(0ns); });
+
+   // Assert
+   ASSERT_EQ(std::future_status::ready, polled.wait_for(5s));
+   ASSERT_TRUE(handler.rearmed);
+   target->stop_monitoring(handler.fd);
+   (void)::close(fd);
+}
+
+
+
+TEST_F(event_engine_tests, start_monitoring_given_range_of_handles_should_register_each_with_service) {
+   // Arrange
+   auto target = create_target<fake_service>();
+   std::vector<std::pair<testing_handle_type, event_engine_tests *>> registrations{{::dup(0), this}, {::dup(0), this}, {{}, this}};
+   EXPECT_CALL(*fake_service::singleton, start_monitoring(static_cast<int>(registrations[0].first), mode::read, this))
+      .Times(1);
+   EXPECT_CALL(*fake_service::singleton, start_monitoring(static_cast<int>(registrations[1].first), mode::read, this))
+      .Times(1);
+
+   // Act
+   target->template start_monitoring<event_engine_tests, &event_engine_tests::on_activation>(registrations.begin(), registrations.end(), mode::read);
+
+   // Assert
+   // On mock expiration
+}
+
 }
@@ -0,0 +1,181 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "file_watcher.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+typedef event_engine<epoll_service> engine_type;
+typedef file_watcher<engine_type> watcher_type;
+
+
+struct recording_handler {
+   void on_change(std::uint32_t mask) {
+      changes.push_back(mask);
+   }
+
+   std::vector<std::uint32_t> changes;
+};
+
+
+struct file_watcher_tests : ::testing::Test {
+   file_watcher_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<engine_type>(10)),
+      directory()
+   {
+      char name[] = "/tmp/file_watcher_testsXXXXXX";
+      directory = ::mkdtemp(name);
+   }
+
+   virtual ~file_watcher_tests() override {
+      (void)::unlink(path("watched").c_str());
+      (void)::unlink(path("other").c_str());
+      (void)::rmdir(directory.c_str());
+   }
+
+   inline std::string path(const char *name) const {
+      return directory + "/" + name;
+   }
+
+   inline void append(const std::string &file, int times) {
+      int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+      ASSERT_LE(0, fd);
+      for (int i = 0; i < times; ++i) {
+         ASSERT_EQ(1, ::write(fd, "x", 1));
+      }
+      (void)::close(fd);
+   }
+
+   std::shared_ptr<engine_type> engine;
+   std::string directory;
+};
+
+
+TEST_F(file_watcher_tests, poll_given_burst_of_writes_should_call_handler_once) {
+   // Arrange
+   append(path("watched"), 1);
+   watcher_type target{*engine};
+   recording_handler handler;
+   std::error_code error;
+   (void)target.watch(path("watched"), IN_MODIFY | IN_CLOSE_WRITE,
+                      watcher_type::create_handler<recording_handler, &recording_handler::on_change>(handler), error);
+   ASSERT_EQ(std::error_code{}, error);
+
+   // Act
+   append(path("watched"), 20);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(1U, handler.changes.size());
+   ASSERT_EQ(static_cast<std::uint32_t>(IN_MODIFY | IN_CLOSE_WRITE), handler.changes.front());
+}
+
+
+TEST_F(file_watcher_tests, poll_given_removed_file_should_report_it_and_forget_watch) {
+   // Arrange
+   append(path("watched"), 1);
+   watcher_type target{*engine};
+   recording_handler handler;
+   std::error_code error;
+   auto watch = target.watch(path("watched"), IN_DELETE_SELF,
+                             watcher_type::create_handler<recording_handler, &recording_handler::on_change>(handler), error);
+
+   // Act
+   (void)::unlink(path("watched").c_str());
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(1U, handler.changes.size());
+   ASSERT_NE(0U, handler.changes.front() & IN_DELETE_SELF);
+   ASSERT_NE(0U, handler.changes.front() & IN_IGNORED);
+   ASSERT_FALSE(target.watching(watch));
+   ASSERT_EQ(0U, target.size());
+}
+
+
+TEST_F(file_watcher_tests, poll_after_unwatch_should_not_call_handler) {
+   // Arrange
+   append(path("watched"), 1);
+   watcher_type target{*engine};
+   recording_handler handler;
+   std::error_code error;
+   auto watch = target.watch(path("watched"), IN_MODIFY,
+                             watcher_type::create_handler<recording_handler, &recording_handler::on_change>(handler), error);
+
+   // Act
+   auto unwatched = target.unwatch(watch);
+   append(path("watched"), 3);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, unwatched);
+   ASSERT_TRUE(handler.changes.empty());
+}
+
+
+TEST_F(file_watcher_tests, watch_after_earlier_watches_were_dropped_should_route_events_to_the_new_handler) {
+   // Arrange
+   append(path("watched"), 1);
+   append(path("other"), 1);
+   watcher_type target{*engine};
+   recording_handler dropped;
+   recording_handler current;
+   std::error_code error;
+   std::vector<watcher_type::watch_type> old_watches;
+   for (int i = 0; i < 20; ++i) {
+      old_watches.push_back(target.watch(path("watched"), IN_MODIFY,
+                                         watcher_type::create_handler<recording_handler, &recording_handler::on_change>(dropped),
+                                         error));
+      ASSERT_EQ(std::error_code{}, target.unwatch(old_watches.back()));
+   }
+
+   // Act
+   auto watch = target.watch(path("other"), IN_MODIFY,
+                             watcher_type::create_handler<recording_handler, &recording_handler::on_change>(current), error);
+   append(path("watched"), 3);
+   append(path("other"), 3);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_TRUE(dropped.changes.empty());
+   ASSERT_EQ(1U, current.changes.size());
+   ASSERT_EQ(static_cast<std::uint32_t>(IN_MODIFY), current.changes.front() & IN_MODIFY);
+   ASSERT_TRUE(target.watching(watch));
+   ASSERT_EQ(1U, target.size());
+   for (auto w : old_watches) {
+      ASSERT_NE(watch, w);
+      ASSERT_FALSE(target.watching(w));
+   }
+}
+
+
+TEST_F(file_watcher_tests, watch_given_missing_path_should_fail) {
+   // Arrange
+   watcher_type target{*engine};
+   recording_handler handler;
+   std::error_code error;
+
+   // Act
+   auto watch = target.watch(path("missing"), IN_MODIFY,
+                             watcher_type::create_handler<recording_handler, &recording_handler::on_change>(handler), error);
+
+   // Assert
+   ASSERT_EQ(-1, watch);
+   ASSERT_EQ(std::errc::no_such_file_or_directory, error);
+}
+
+}
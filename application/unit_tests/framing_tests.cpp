@@ -0,0 +1,179 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "framing.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+
+
+struct framing_tests : ::testing::Test {
+   framing_tests() :
+      ::testing::Test(),
+      frames()
+   {
+   }
+
+   void on_frame(std::experimental::string_view frame) {
+      frames.push_back(frame.to_string());
+   }
+
+   std::vector<std::string> frames;
+};
+
+
+std::vector<details_::find_byte_type> supported_find_bytes() {
+   std::vector<details_::find_byte_type> result{&details_::find_byte_scalar, &details_::find_byte};
+#if defined(__SSE2__)
+   result.push_back(&details_::find_byte_sse2);
+   if (__builtin_cpu_supports("avx2")) {
+      result.push_back(&details_::find_byte_avx2);
+   }
+#endif
+   return result;
+}
+
+
+TEST(find_byte, every_implementation_should_find_first_occurrence_at_any_offset_and_length) {
+   // Arrange
+   std::mt19937 random{7U};
+   std::string data(200U, 'x');
+   for (auto &c : data) {
+      c = static_cast<char>('a' + random() % 20U);
+   }
+
+   // Act & Assert
+   for (auto find : supported_find_bytes()) {
+      for (std::size_t first = 0U; first < 40U; ++first) {
+         for (std::size_t size = 0U; first + size <= data.size(); size += 7U) {
+            std::size_t expected = data.substr(first, size).find('q');
+            expected = (expected == std::string::npos) ? size : expected;
+            ASSERT_EQ(expected, find(data.data() + first, size, 'q'));
+         }
+      }
+   }
+}
+
+
+TEST_F(framing_tests, line_framer_should_split_lines_ending_in_lf_or_crlf_and_keep_remainder) {
+   // Arrange
+   line_framer target{64U, line_framer::create_listener<framing_tests, &framing_tests::on_frame>(*this)};
+   std::string data = "first\r\nsecond\n\nthird, incomp";
+   std::error_code error;
+
+   // Act
+   auto consumed = target.feed(data.data(), data.size(), error);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_EQ((std::vector<std::string>{"first", "second", ""}), frames);
+   ASSERT_EQ(data.find("third"), consumed);
+}
+
+
+TEST_F(framing_tests, line_framer_given_remainder_again_with_more_data_should_complete_line) {
+   // Arrange
+   line_framer target{64U, line_framer::create_listener<framing_tests, &framing_tests::on_frame>(*this)};
+   std::string data = "a line that arrives in two pieces";
+   std::error_code error;
+   auto first = target.feed(data.data(), 10U, error);
+
+   // Act
+   data += "\n";
+   auto second = target.feed(data.data(), data.size(), error);
+
+   // Assert
+   ASSERT_EQ(0U, first);
+   ASSERT_EQ(data.size(), second);
+   ASSERT_EQ(std::vector<std::string>{"a line that arrives in two pieces"}, frames);
+}
+
+
+TEST_F(framing_tests, line_framer_given_line_longer_than_maximum_should_fail) {
+   // Arrange
+   line_framer target{4U, line_framer::create_listener<framing_tests, &framing_tests::on_frame>(*this)};
+   std::string data = "ok\nway too long";
+   std::error_code error;
+
+   // Act
+   auto consumed = target.feed(data.data(), data.size(), error);
+
+   // Assert
+   ASSERT_EQ(std::make_error_code(std::errc::message_size), error);
+   ASSERT_EQ(3U, consumed);
+   ASSERT_EQ(std::vector<std::string>{"ok"}, frames);
+}
+
+
+TEST_F(framing_tests, line_framer_given_less_data_than_was_scanned_should_scan_it_from_the_start) {
+   // Arrange
+   line_framer target{64U, line_framer::create_listener<framing_tests, &framing_tests::on_frame>(*this)};
+   std::string partial = "an unfinished line";
+   std::error_code error;
+   (void)target.feed(partial.data(), partial.size(), error);
+
+   // Act
+   std::string shorter = "x\n";
+   auto consumed = target.feed(shorter.data(), shorter.size(), error);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_EQ(shorter.size(), consumed);
+   ASSERT_EQ(std::vector<std::string>{"x"}, frames);
+}
+
+
+TEST_F(framing_tests, line_framer_after_reset_should_scan_new_data_from_the_start) {
+   // Arrange
+   line_framer target{64U, line_framer::create_listener<framing_tests, &framing_tests::on_frame>(*this)};
+   std::string partial = "an unfinished line";
+   std::error_code error;
+   (void)target.feed(partial.data(), partial.size(), error);
+
+   // Act
+   target.reset();
+   std::string fresh = "ab\nand a longer remainder";
+   auto consumed = target.feed(fresh.data(), fresh.size(), error);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_EQ(3U, consumed);
+   ASSERT_EQ(std::vector<std::string>{"ab"}, frames);
+}
+
+
+TEST_F(framing_tests, length_prefixed_framer_should_hand_out_complete_payloads_only) {
+   // Arrange
+   length_prefixed_framer target{1024U, length_prefixed_framer::create_listener<framing_tests, &framing_tests::on_frame>(*this)};
+   std::string data{"\0\0\0\5hello\0\0\0\0\0\0\0\7par", 20U};
+   std::error_code error;
+
+   // Act
+   auto consumed = target.feed(data.data(), data.size(), error);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_EQ((std::vector<std::string>{"hello", ""}), frames);
+   ASSERT_EQ(13U, consumed);
+}
+
+
+TEST_F(framing_tests, length_prefixed_framer_given_oversized_header_should_fail) {
+   // Arrange
+   length_prefixed_framer target{16U, length_prefixed_framer::create_listener<framing_tests, &framing_tests::on_frame>(*this)};
+   std::string data{"\0\1\0\0", 4U};
+   std::error_code error;
+
+   // Act
+   auto consumed = target.feed(data.data(), data.size(), error);
+
+   // Assert
+   ASSERT_EQ(std::make_error_code(std::errc::message_size), error);
+   ASSERT_EQ(0U, consumed);
+   ASSERT_TRUE(frames.empty());
+}
+
+}
@@ -0,0 +1,150 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "handoff.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+typedef event_engine<epoll_service> engine_type;
+typedef handoff_receiver<engine_type> receiver_type;
+
+constexpr std::uint32_t listener_kind = 1U;
+constexpr std::uint32_t counter_kind = 2U;
+
+
+struct handoff_tests : ::testing::Test {
+   handoff_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<engine_type>(10)),
+      path("/tmp/handoff_tests." + std::to_string(::getpid())),
+      received(),
+      batches(0U),
+      completions(0U),
+      last_error()
+   {
+   }
+
+   virtual ~handoff_tests() override {
+      for (const handed_off &h : received) {
+         (void)::close(h.handle);
+      }
+   }
+
+   inline std::unique_ptr<receiver_type> create_target() {
+      return std::make_unique<receiver_type>(*engine, path,
+                                             receiver_type::create_listener<handoff_tests, &handoff_tests::on_handoff>(*this));
+   }
+
+   inline std::error_code hand_off_while_polling(const std::vector<handed_off> &handles) {
+      auto sender = std::async(std::launch::async, [this, &handles] { return hand_off(path, handles); });
+      while (sender.wait_for(0s) != std::future_status::ready) {
+         (void)engine->poll(10ms);
+      }
+      return sender.get();
+   }
+
+   void on_handoff(std::vector<handed_off> &batch, std::error_code error) {
+      if (batch.empty()) {
+         ++completions;
+         last_error = error;
+      }
+      else {
+         ++batches;
+         received.insert(received.end(), batch.begin(), batch.end());
+      }
+   }
+
+   std::shared_ptr<engine_type> engine;
+   std::string path;
+   std::vector<handed_off> received;
+   std::size_t batches;
+   std::size_t completions;
+   std::error_code last_error;
+};
+
+
+TEST_F(handoff_tests, hand_off_should_pass_listening_socket_that_keeps_its_queue) {
+   // Arrange
+   auto target = create_target();
+   int listening = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   sockaddr_in address{};
+   address.sin_family = AF_INET;
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   socklen_t length = sizeof(address);
+   ASSERT_EQ(0, ::bind(listening, reinterpret_cast<sockaddr *>(&address), sizeof(address)));
+   ASSERT_EQ(0, ::listen(listening, 16));
+   ASSERT_EQ(0, ::getsockname(listening, reinterpret_cast<sockaddr *>(&address), &length));
+   int client = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   ASSERT_EQ(0, ::connect(client, reinterpret_cast<sockaddr *>(&address), sizeof(address)));
+
+   // Act
+   auto error = hand_off_while_polling({{listening, listener_kind}});
+   (void)::close(listening);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_EQ(1U, completions);
+   ASSERT_EQ(std::error_code{}, last_error);
+   ASSERT_EQ(1U, received.size());
+   ASSERT_EQ(listener_kind, received[0].kind);
+   int accepted = ::accept4(received[0].handle, nullptr, nullptr, SOCK_CLOEXEC);
+   ASSERT_LE(0, accepted);
+   (void)::close(accepted);
+   (void)::close(client);
+}
+
+
+TEST_F(handoff_tests, hand_off_given_more_handles_than_fit_in_a_message_should_pass_all_in_order) {
+   // Arrange
+   auto target = create_target();
+   std::vector<handed_off> handles;
+   for (std::uint32_t i = 0U; i < 300U; ++i) {
+      handles.push_back({::eventfd(i + 1U, EFD_NONBLOCK | EFD_CLOEXEC), counter_kind + i});
+   }
+
+   // Act
+   auto error = hand_off_while_polling(handles);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_EQ(1U, completions);
+   ASSERT_EQ(300U, received.size());
+   for (std::uint32_t i = 0U; i < 300U; ++i) {
+      ASSERT_EQ(counter_kind + i, received[i].kind);
+      ::eventfd_t value = 0U;
+      ASSERT_EQ(0, ::eventfd_read(received[i].handle, &value));
+      ASSERT_EQ(i + 1U, value);
+   }
+   for (const handed_off &h : handles) {
+      (void)::close(h.handle);
+   }
+}
+
+
+TEST_F(handoff_tests, hand_off_without_receiver_should_fail) {
+   // Arrange
+   int counter = ::eventfd(0, EFD_CLOEXEC);
+
+   // Act
+   auto error = hand_off(path + ".missing", {{counter, counter_kind}});
+
+   // Assert
+   ASSERT_TRUE(static_cast<bool>(error));
+   (void)::close(counter);
+}
+
+}
@@ -0,0 +1,147 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "idle_tracker.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+typedef event_engine<epoll_service> engine_type;
+typedef idle_tracker<engine_type> tracker_type;
+
+
+struct idle_tracker_tests : ::testing::Test {
+   idle_tracker_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<engine_type>(10)),
+      expired()
+   {
+   }
+
+   inline std::unique_ptr<tracker_type> create_target(std::chrono::nanoseconds timeout, std::chrono::nanoseconds granularity) {
+      return std::make_unique<tracker_type>(*engine, timeout, granularity,
+                                            tracker_type::create_listener<idle_tracker_tests, &idle_tracker_tests::on_idle>(*this));
+   }
+
+   inline bool has_expired(native_handle_type h) const {
+      return std::find(expired.begin(), expired.end(), h) != expired.end();
+   }
+
+   void on_idle(native_handle_type h) {
+      expired.push_back(h);
+   }
+
+   std::shared_ptr<engine_type> engine;
+   std::vector<native_handle_type> expired;
+};
+
+
+TEST_F(idle_tracker_tests, expire_given_untouched_handle_should_report_it_once) {
+   // Arrange
+   auto target = create_target(20ms, 5ms);
+   target->track(7);
+
+   // Act
+   target->expire(engine->time() + 40ms);
+   target->expire(engine->time() + 80ms);
+
+   // Assert
+   ASSERT_EQ(std::vector<native_handle_type>{7}, expired);
+   ASSERT_FALSE(target->tracking(7));
+   ASSERT_EQ(0U, target->size());
+}
+
+
+TEST_F(idle_tracker_tests, expire_before_timeout_should_not_report_handle) {
+   // Arrange
+   auto target = create_target(20ms, 5ms);
+   target->track(7);
+
+   // Act
+   target->expire(engine->time() + 10ms);
+
+   // Assert
+   ASSERT_TRUE(expired.empty());
+   ASSERT_TRUE(target->tracking(7));
+}
+
+
+TEST_F(idle_tracker_tests, expire_given_forgotten_handle_should_not_report_it) {
+   // Arrange
+   auto target = create_target(20ms, 5ms);
+   target->track(7);
+   target->forget(7);
+
+   // Act
+   target->expire(engine->time() + 40ms);
+
+   // Assert
+   ASSERT_TRUE(expired.empty());
+}
+
+
+TEST_F(idle_tracker_tests, touch_given_untracked_handle_should_ignore_it) {
+   // Arrange
+   auto target = create_target(20ms, 5ms);
+   target->track(7);
+   target->forget(7);
+
+   // Act
+   target->touch(-1);
+   target->touch(3);
+   target->touch(7);
+   target->touch(1000);
+   target->expire(engine->time() + 40ms);
+
+   // Assert
+   ASSERT_TRUE(expired.empty());
+   ASSERT_FALSE(target->tracking(3));
+   ASSERT_FALSE(target->tracking(1000));
+   ASSERT_EQ(0U, target->size());
+}
+
+
+TEST_F(idle_tracker_tests, constructor_given_granularity_out_of_range_should_throw_invalid_argument) {
+   for (auto granularity : {std::chrono::nanoseconds{0}, std::chrono::nanoseconds{-5ms}, std::chrono::nanoseconds{30ms}}) {
+      // Act
+      std::error_code error;
+      try {
+         (void)create_target(20ms, granularity);
+      }
+      catch (const std::system_error &e) {
+         error = e.code();
+      }
+
+      // Assert
+      ASSERT_EQ(std::make_error_code(std::errc::invalid_argument), error);
+   }
+}
+
+
+TEST_F(idle_tracker_tests, polling_should_reap_idle_handles_but_not_touched_ones) {
+   // Arrange
+   auto target = create_target(30ms, 5ms);
+   target->track(7);
+   target->track(8);
+
+   // Act
+   auto stop = std::chrono::steady_clock::now() + 100ms;
+   while (std::chrono::steady_clock::now() < stop) {
+      (void)engine->poll(5ms);
+      target->touch(8);
+   }
+
+   // Assert
+   ASSERT_TRUE(has_expired(7));
+   ASSERT_FALSE(has_expired(8));
+   ASSERT_TRUE(target->tracking(8));
+}
+
+}
@@ -0,0 +1,113 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "mirrored_buffer.h"
+#include "framing.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+
+
+struct mirrored_buffer_tests : ::testing::Test {
+   mirrored_buffer_tests() :
+      ::testing::Test(),
+      fds{-1, -1},
+      frames()
+   {
+      EXPECT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds));
+   }
+
+   virtual ~mirrored_buffer_tests() override {
+      (void)::close(fds[0]);
+      (void)::close(fds[1]);
+   }
+
+   inline void send_peer(const std::string &data) {
+      ASSERT_EQ(static_cast<ssize_t>(data.size()), ::write(fds[1], data.data(), data.size()));
+   }
+
+   void on_frame(std::experimental::string_view frame) {
+      frames.push_back(frame.to_string());
+   }
+
+   int fds[2];
+   std::vector<std::string> frames;
+};
+
+
+TEST_F(mirrored_buffer_tests, data_wrapping_past_the_end_should_read_back_contiguously) {
+   // Arrange
+   mirrored_buffer target{1U};
+   std::size_t capacity = target.capacity();
+   target.commit(capacity - 3U);
+   target.consume(capacity - 3U);
+
+   // Act
+   std::memcpy(target.free_space(), "wrapped", 7U);
+   target.commit(7U);
+
+   // Assert
+   ASSERT_EQ("wrapped", std::string(target.data(), target.size()));
+   ASSERT_EQ(capacity - 7U, target.space());
+}
+
+
+TEST_F(mirrored_buffer_tests, receive_and_deliver_should_frame_lines_straddling_the_end_without_copying) {
+   // Arrange
+   mirrored_buffer target{1U};
+   line_framer framer{target.capacity(), line_framer::create_listener<mirrored_buffer_tests, &mirrored_buffer_tests::on_frame>(*this)};
+   std::string filler(target.capacity() - 5U, 'f');
+   filler.back() = '\n';
+   send_peer(filler);
+   std::error_code error;
+   (void)target.receive(fds[0], error);
+   (void)target.deliver(framer, error);
+
+   // Act
+   send_peer("straddling\nrest");
+   auto received = target.receive(fds[0], error);
+   auto delivered = target.deliver(framer, error);
+
+   // Assert
+   ASSERT_EQ(15U, received);
+   ASSERT_EQ(11U, delivered);
+   ASSERT_EQ(std::string("straddling"), frames.back());
+   ASSERT_EQ("rest", std::string(target.data(), target.size()));
+}
+
+
+TEST_F(mirrored_buffer_tests, receive_when_drained_should_report_try_again) {
+   // Arrange
+   mirrored_buffer target{4096U};
+   std::error_code error;
+
+   // Act
+   auto received = target.receive(fds[0], error);
+
+   // Assert
+   ASSERT_EQ(0U, received);
+   ASSERT_EQ(std::make_error_code(std::errc::resource_unavailable_try_again), error);
+}
+
+
+TEST_F(mirrored_buffer_tests, receive_when_full_should_not_look_like_end_of_stream) {
+   // Arrange
+   mirrored_buffer target{1U};
+   target.commit(target.capacity());
+   send_peer("more");
+   std::error_code error;
+
+   // Act
+   auto received = target.receive(fds[0], error);
+
+   // Assert
+   ASSERT_EQ(0U, received);
+   ASSERT_EQ(std::make_error_code(std::errc::no_buffer_space), error);
+}
+
+}
@@ -6,6 +6,7 @@
 #include <experimental/thread_pool>
 #include <future>
 #include <memory>
+#include <thread>
 
 namespace {
 
@@ -37,6 +38,10 @@ struct notification_tests : public ::testing::Test {
    inline void run() {
       if (!polling_result.valid()) {
          polling_result = async(launch::async, [=] { return engine->run(); });
+         // run() forgets a quit() that comes before it starts.
+         while (!engine->polling()) {
+            this_thread::yield();
+         }
       }
    }
 
@@ -95,4 +100,75 @@ TEST_F(notification_tests, constructor) {
    pool.join();
 }
 
+
+TEST_F(notification_tests, set_while_pending_should_coalesce_into_one_wakeup) {
+   // Arrange
+   auto target = create_target();
+   target->set(1);
+
+   // Act
+   target->set(2);
+   target->set(3);
+   (void)try_poll();
+
+   // Assert
+   ASSERT_EQ(1U, target->get());
+   ASSERT_FALSE(target->pending());
+}
+
+
+TEST_F(notification_tests, set_racing_activation_should_never_lose_a_wakeup) {
+   // Arrange
+   struct observer {
+      void on_notified(uint64_t) {
+         seen.store(published.load());
+      }
+      atomic<uint64_t> published;
+      atomic<uint64_t> seen;
+   } o{{0U}, {0U}};
+   notification target{*engine, notification::behavior::conditional, 0,
+                       notification::create_listener<observer, &observer::on_notified>(o)};
+   atomic<bool> done{false};
+   auto poller = async(launch::async, [this, &done] {
+         while (!done.load()) {
+            (void)engine->poll(chrono::milliseconds{100});
+         }
+      });
+
+   // Act
+   auto until = chrono::steady_clock::now() + chrono::milliseconds{300};
+   while (chrono::steady_clock::now() < until) {
+      for (int i = 0; i < 1000; ++i) {
+         o.published.fetch_add(1U);
+         target.set(1);
+      }
+   }
+   uint64_t last = o.published.fetch_add(1U) + 1U;
+   target.set(1);
+   auto deadline = chrono::steady_clock::now() + seconds{5};
+   while ((o.seen.load() != last) && (chrono::steady_clock::now() < deadline)) {
+      this_thread::yield();
+   }
+   done = true;
+   poller.get();
+
+   // Assert
+   ASSERT_EQ(last, o.seen.load());
+}
+
+
+TEST_F(notification_tests, set_after_activation_should_wake_up_again) {
+   // Arrange
+   auto target = create_target();
+   target->set(1);
+   (void)try_poll();
+
+   // Act
+   target->set(2);
+   (void)try_poll();
+
+   // Assert
+   ASSERT_EQ(2U, target->get());
+}
+
 }
@@ -0,0 +1,187 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "numa.h"
+#include "buffer_pool.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <sched.h>
+#include <set>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+
+// Binding changes the affinity of the thread running the tests; put it back afterwards.
+struct numa_binding_tests : ::testing::Test {
+   numa_binding_tests() :
+      ::testing::Test(),
+      saved_cpus()
+   {
+      CPU_ZERO(&saved_cpus);
+      (void)::sched_getaffinity(0, sizeof(saved_cpus), &saved_cpus);
+   }
+
+   virtual ~numa_binding_tests() override {
+      (void)::sched_setaffinity(0, sizeof(saved_cpus), &saved_cpus);
+   }
+
+   ::cpu_set_t saved_cpus;
+};
+
+
+TEST(numa, current_numa_node_should_be_one_of_the_online_nodes) {
+   // Act
+   int actual = current_numa_node();
+
+   // Assert
+   ASSERT_LE(0, actual);
+   ASSERT_GT(numa_node_count(), actual);
+}
+
+
+TEST(numa, allocate_on_numa_node_should_return_usable_memory) {
+   // Arrange
+   constexpr std::size_t size = 3U * 4096U + 10U;
+
+   // Act
+   void *actual = allocate_on_numa_node(size, current_numa_node());
+
+   // Assert
+   ASSERT_NE(nullptr, actual);
+   std::memset(actual, 0xa5, size);
+   ASSERT_EQ(0xa5, static_cast<unsigned char*>(actual)[size - 1U]);
+   deallocate_on_numa_node(actual, size);
+}
+
+
+TEST(numa, numa_allocator_should_carry_its_node_through_containers) {
+   // Arrange
+   std::vector<int, numa_allocator<int>> source(100, 7, numa_allocator<int>{0});
+   std::vector<int, numa_allocator<int>> target(numa_allocator<int>{any_numa_node});
+
+   // Act
+   target = std::move(source);
+
+   // Assert
+   ASSERT_EQ(0, target.get_allocator().node());
+   ASSERT_EQ(100U, target.size());
+   ASSERT_EQ(7, target.back());
+}
+
+
+TEST_F(numa_binding_tests, bind_to_numa_node_given_current_node_should_keep_thread_there) {
+   // Arrange
+   int node = current_numa_node();
+
+   // Act
+   auto actual = bind_to_numa_node(node);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, actual);
+   ASSERT_EQ(node, current_numa_node());
+}
+
+
+TEST_F(numa_binding_tests, bind_to_numa_node_given_nonexistent_node_should_fail) {
+   // Act
+   auto actual = bind_to_numa_node(numa_node_count() + 1);
+
+   // Assert
+   ASSERT_TRUE(static_cast<bool>(actual));
+}
+
+
+TEST_F(numa_binding_tests, event_engine_bound_to_a_node_should_keep_dispatching) {
+   // Arrange
+   struct handler {
+      void on_activation(mode flags) {
+         activation_flags = flags;
+      }
+
+      mode activation_flags;
+   };
+   struct testing_tag {};
+   auto engine = std::make_shared<event_engine<epoll_service>>(10);
+   handler h{mode::none};
+   handle<testing_tag, int, -1> fd{::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC)};
+   int raw_fd = fd;
+   engine->start_monitoring<handler, &handler::on_activation>(fd, mode::read, h);
+
+   // Act
+   auto bound = engine->bind_to_numa_node(current_numa_node());
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, bound);
+   ASSERT_EQ(mode::read, h.activation_flags);
+   engine->stop_monitoring(fd);
+   (void)::close(raw_fd);
+}
+
+
+TEST_F(numa_binding_tests, event_engine_bind_to_numa_node_while_running_should_fail_and_leave_it_polling) {
+   // Arrange
+   auto engine = std::make_shared<event_engine<epoll_service>>(10);
+   auto running = std::async(std::launch::async, [&engine] { return engine->run(5s); });
+   while (!engine->polling()) {
+      std::this_thread::yield();
+   }
+
+   // Act
+   auto bound = engine->bind_to_numa_node(current_numa_node());
+   engine->quit();
+
+   // Assert
+   ASSERT_EQ(std::make_error_code(std::errc::device_or_resource_busy), bound);
+   ASSERT_EQ(std::future_status::ready, running.wait_for(5s));
+   ASSERT_EQ(std::error_code{}, running.get());
+}
+
+
+TEST(buffer_pool, acquire_should_hand_out_distinct_aligned_buffers_until_exhausted) {
+   // Arrange
+   buffer_pool target{100U, 4U};
+   std::set<void*> acquired;
+
+   // Act
+   for (int i = 0; i < 4; ++i) {
+      acquired.insert(target.acquire());
+   }
+   void *exhausted = target.acquire();
+
+   // Assert
+   ASSERT_EQ(4U, acquired.size());
+   ASSERT_EQ(0U, acquired.count(nullptr));
+   ASSERT_EQ(nullptr, exhausted);
+   for (void *buffer : acquired) {
+      ASSERT_EQ(0U, reinterpret_cast<std::uintptr_t>(buffer) % buffer_pool::alignment);
+   }
+   ASSERT_LE(100U, target.buffer_size());
+}
+
+
+TEST(buffer_pool, release_should_make_buffer_available_again) {
+   // Arrange
+   buffer_pool target{64U, 1U};
+   void *buffer = target.acquire();
+
+   // Act
+   target.release(buffer);
+
+   // Assert
+   ASSERT_EQ(1U, target.available());
+   ASSERT_EQ(buffer, target.acquire());
+}
+
+}
@@ -0,0 +1,91 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "offload_pool.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+
+struct offload_pool_tests : ::testing::Test {
+   offload_pool_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<event_engine<epoll_service>>(10))
+   {
+   }
+
+   template<class Predicate>
+   inline void poll_until(Predicate done) {
+      for (int i = 0; (i < 100) && !done(); ++i) {
+         (void)engine->poll(50ms);
+      }
+   }
+
+   std::shared_ptr<event_engine<epoll_service>> engine;
+};
+
+
+TEST_F(offload_pool_tests, submit_should_run_completion_with_result_on_polling_thread) {
+   // Arrange
+   offload_pool target{*engine, 2, 8};
+   int actual = 0;
+   std::thread::id blocking_thread;
+   std::thread::id completion_thread;
+
+   // Act
+   auto error = target.submit([&blocking_thread] {
+            blocking_thread = std::this_thread::get_id();
+            return 42;
+         },
+         [&actual, &completion_thread] (int result) {
+            actual = result;
+            completion_thread = std::this_thread::get_id();
+         });
+   poll_until([&actual] { return actual != 0; });
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_EQ(42, actual);
+   ASSERT_NE(std::this_thread::get_id(), blocking_thread);
+   ASSERT_EQ(std::this_thread::get_id(), completion_thread);
+   ASSERT_EQ(0U, target.outstanding());
+}
+
+
+TEST_F(offload_pool_tests, submit_given_void_call_should_run_completion_without_result) {
+   // Arrange
+   offload_pool target{*engine, 1, 8};
+   bool completed = false;
+
+   // Act
+   (void)target.submit([] {}, [&completed] { completed = true; });
+   poll_until([&completed] { return completed; });
+
+   // Assert
+   ASSERT_TRUE(completed);
+}
+
+
+TEST_F(offload_pool_tests, submit_when_at_capacity_should_fail_with_try_again) {
+   // Arrange
+   offload_pool target{*engine, 1, 1};
+   std::promise<void> release;
+   auto released = release.get_future().share();
+   (void)target.submit([released] { released.wait(); }, [] {});
+
+   // Act
+   auto actual = target.submit([] {}, [] {});
+
+   // Assert
+   ASSERT_EQ(std::make_error_code(std::errc::resource_unavailable_try_again), actual);
+   release.set_value();
+}
+
+}
@@ -27,6 +27,22 @@ void PrintTo(mode flags, std::ostream *os) {
       out_flags.emplace_back("one time");
    }
 
+   if ((flags & mode::rearm) != mode::none) {
+      out_flags.emplace_back("rearm");
+   }
+
+   if ((flags & mode::hangup) != mode::none) {
+      out_flags.emplace_back("hangup");
+   }
+
+   if ((flags & mode::error) != mode::none) {
+      out_flags.emplace_back("error");
+   }
+
+   if ((flags & mode::exclusive) != mode::none) {
+      out_flags.emplace_back("exclusive");
+   }
+
    if (flags == mode::none) {
       out_flags.emplace_back("none");
    }
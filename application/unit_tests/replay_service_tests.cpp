@@ -0,0 +1,156 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "replay_service.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include "readiness_trace.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+struct testing_tag {};
+
+typedef handle<testing_tag, int, -1> testing_handle_type;
+
+
+struct counting_handler {
+   void on_activation(mode flags) {
+      ++activations;
+      seen = seen | flags;
+   }
+
+   int activations;
+   mode seen;
+};
+
+
+struct replay_service_tests : ::testing::Test {
+   replay_service_tests() :
+      ::testing::Test(),
+      path("/tmp/epolling-trace-XXXXXX"),
+      fd(-1)
+   {
+      int file = ::mkstemp(&path[0]);
+      EXPECT_LE(0, file);
+      (void)::close(file);
+      fd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+   }
+
+   virtual ~replay_service_tests() override {
+      (void)::unlink(path.c_str());
+      (void)::close(fd);
+   }
+
+   // Polls a real engine for the given number of batches, some time apart, with the eventfd readable in each.
+   inline void record(int batches, std::chrono::milliseconds apart) {
+      auto engine = std::make_shared<event_engine<epoll_service>>(10);
+      auto &service = std::experimental::use_service<epoll_service>(*engine);
+      counting_handler handler{0, mode::none};
+      testing_handle_type h{fd};
+      engine->start_monitoring<counting_handler, &counting_handler::on_activation>(h, mode::read, handler);
+      {
+         trace_recorder recorder{path.c_str()};
+         service.set_recorder(&recorder);
+         for (int i = 0; i < batches; ++i) {
+            if (i > 0) {
+               std::this_thread::sleep_for(apart);
+               std::uint64_t one = 1U;
+               ASSERT_EQ(static_cast<ssize_t>(sizeof(one)), ::write(fd, &one, sizeof(one)));
+            }
+            ASSERT_TRUE(engine->poll(0ns));
+         }
+         service.set_recorder(nullptr);
+      }
+      engine->stop_monitoring(h);
+   }
+
+   std::string path;
+   int fd;
+};
+
+
+TEST_F(replay_service_tests, recording_should_log_each_batch_with_handle_and_flags) {
+   // Arrange
+   record(2, 1ms);
+   readiness_trace target;
+
+   // Act
+   auto error = target.load(path.c_str());
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_EQ(2U, target.batches().size());
+   ASSERT_EQ(1U, target.batches()[0].count);
+   ASSERT_EQ(fd, target.event(0).handle);
+   ASSERT_EQ(static_cast<std::uint32_t>(mode::read), target.event(0).flags);
+   ASSERT_LT(target.batches()[0].at, target.batches()[1].at);
+}
+
+
+TEST_F(replay_service_tests, replay_should_deliver_recorded_events_to_handlers_registered_under_the_same_handles) {
+   // Arrange
+   record(3, 1ms);
+   readiness_trace trace;
+   ASSERT_EQ(std::error_code{}, trace.load(path.c_str()));
+   auto engine = std::make_shared<event_engine<replay_service>>(10);
+   auto &target = std::experimental::use_service<replay_service>(*engine);
+   target.set_trace(trace, replay_service::pacing::as_fast_as_possible);
+   counting_handler handler{0, mode::none};
+   engine->start_monitoring<counting_handler, &counting_handler::on_activation>(testing_handle_type{fd}, mode::read, handler);
+
+   // Act
+   while (!target.finished()) {
+      (void)engine->poll(0ns);
+   }
+
+   // Assert
+   ASSERT_EQ(3, handler.activations);
+   ASSERT_EQ(mode::read, handler.seen);
+}
+
+
+TEST_F(replay_service_tests, replay_at_original_pace_should_take_as_long_as_the_recording) {
+   // Arrange
+   record(2, 30ms);
+   readiness_trace trace;
+   ASSERT_EQ(std::error_code{}, trace.load(path.c_str()));
+   auto engine = std::make_shared<event_engine<replay_service>>(10);
+   auto &target = std::experimental::use_service<replay_service>(*engine);
+   target.set_trace(trace, replay_service::pacing::original);
+   counting_handler handler{0, mode::none};
+   engine->start_monitoring<counting_handler, &counting_handler::on_activation>(testing_handle_type{fd}, mode::read, handler);
+
+   // Act
+   auto start = std::chrono::steady_clock::now();
+   while (!target.finished()) {
+      (void)engine->poll(1s);
+   }
+   auto elapsed = std::chrono::steady_clock::now() - start;
+
+   // Assert
+   ASSERT_EQ(2, handler.activations);
+   ASSERT_LE(25ms, elapsed);
+}
+
+
+TEST(readiness_trace, load_given_file_that_is_not_a_trace_should_fail) {
+   // Arrange
+   readiness_trace target;
+
+   // Act
+   auto error = target.load("/proc/self/cmdline");
+
+   // Assert
+   ASSERT_EQ(std::make_error_code(std::errc::invalid_argument), error);
+}
+
+}
@@ -0,0 +1,286 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "shm_channel.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include "handoff.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <future>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+typedef event_engine<epoll_service> engine_type;
+typedef shm_channel<engine_type> channel_type;
+
+
+struct shm_channel_tests : ::testing::Test {
+   shm_channel_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<engine_type>(10)),
+      peer_engine(std::make_shared<engine_type>(10)),
+      received(),
+      peer_received(),
+      peer_errors()
+   {
+   }
+
+   inline std::unique_ptr<channel_type> create_target(std::size_t capacity) {
+      return std::make_unique<channel_type>(*engine, capacity,
+                                            channel_type::create_listener<shm_channel_tests, &shm_channel_tests::on_message>(*this));
+   }
+
+   // What another process would attach with, from its own copies of the descriptors.
+   inline std::unique_ptr<channel_type> attach_peer(const channel_type &target) {
+      std::vector<handed_off> copies = target.handles();
+      for (handed_off &h : copies) {
+         h.handle = ::fcntl(h.handle, F_DUPFD_CLOEXEC, 0);
+      }
+      return attach_peer(copies);
+   }
+
+   inline std::unique_ptr<channel_type> attach_peer(const std::vector<handed_off> &handles) {
+      return std::make_unique<channel_type>(*peer_engine, handles,
+                                            channel_type::create_listener<shm_channel_tests, &shm_channel_tests::on_peer_message>(*this));
+   }
+
+   void on_message(const char *message, std::size_t size, std::error_code error) {
+      (void)error;
+      received.emplace_back(message, size);
+   }
+
+   void on_peer_message(const char *message, std::size_t size, std::error_code error) {
+      if (error) {
+         peer_errors.push_back(error);
+         return;
+      }
+      peer_received.emplace_back(message, size);
+   }
+
+   // Maps the channel's control page as the other process would, to corrupt it.
+   inline details_::shm_control *map_control(const channel_type &target) {
+      void *mapped = ::mmap(nullptr, sizeof(details_::shm_control), PROT_READ | PROT_WRITE, MAP_SHARED,
+                            target.handles()[0].handle, 0);
+      return (mapped == MAP_FAILED) ? nullptr : static_cast<details_::shm_control *>(mapped);
+   }
+
+   std::shared_ptr<engine_type> engine;
+   std::shared_ptr<engine_type> peer_engine;
+   std::vector<std::string> received;
+   std::vector<std::string> peer_received;
+   std::vector<std::error_code> peer_errors;
+};
+
+
+TEST_F(shm_channel_tests, try_send_should_deliver_to_peer_attached_over_handoff_in_order) {
+   // Arrange
+   auto target = create_target(4096);
+   std::string path = "/tmp/shm_channel_tests." + std::to_string(::getpid());
+   std::vector<handed_off> passed;
+   struct collector {
+      void on_handoff(std::vector<handed_off> &batch, std::error_code) {
+         handles.insert(handles.end(), batch.begin(), batch.end());
+      }
+      std::vector<handed_off> &handles;
+   } c{passed};
+   handoff_receiver<engine_type> receiver(*peer_engine, path,
+                                          handoff_receiver<engine_type>::create_listener<collector, &collector::on_handoff>(c));
+   auto handles = target->handles();
+   auto sender = std::async(std::launch::async, [&path, &handles] { return hand_off(path, handles); });
+   while (sender.wait_for(0s) != std::future_status::ready) {
+      (void)peer_engine->poll(10ms);
+   }
+   ASSERT_EQ(std::error_code{}, sender.get());
+   auto peer = attach_peer(passed);
+
+   // Act
+   ASSERT_TRUE(target->try_send("one", 3));
+   ASSERT_TRUE(target->try_send("", 0));
+   ASSERT_TRUE(target->try_send("three", 5));
+   ASSERT_TRUE(peer->try_send("reply", 5));
+   (void)peer_engine->poll(0ns);
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ((std::vector<std::string>{"one", "", "three"}), peer_received);
+   ASSERT_EQ((std::vector<std::string>{"reply"}), received);
+}
+
+
+TEST_F(shm_channel_tests, try_send_should_ring_doorbell_only_when_ring_goes_from_empty_to_not_empty) {
+   // Arrange
+   auto target = create_target(4096);
+   auto peer = attach_peer(*target);
+   int doorbell = target->handles()[1].handle;
+
+   // Act
+   for (int i = 0; i < 3; ++i) {
+      ASSERT_TRUE(target->try_send("x", 1));
+   }
+   ::eventfd_t while_busy = 0U;
+   ASSERT_EQ(0, ::eventfd_read(doorbell, &while_busy));
+   ASSERT_EQ(0, ::eventfd_write(doorbell, while_busy));
+   (void)peer_engine->poll(0ns);
+   ASSERT_TRUE(target->try_send("y", 1));
+   ::eventfd_t after_drain = 0U;
+   ASSERT_EQ(0, ::eventfd_read(doorbell, &after_drain));
+
+   // Assert
+   ASSERT_EQ(1U, while_busy);
+   ASSERT_EQ(1U, after_drain);
+   ASSERT_EQ(3U, peer_received.size());
+}
+
+
+TEST_F(shm_channel_tests, try_send_when_ring_is_full_should_fail_until_drained) {
+   // Arrange
+   auto target = create_target(4096);
+   auto peer = attach_peer(*target);
+   std::string message(target->max_message_size() / 2U, 'm');
+   ASSERT_TRUE(target->try_send(message.data(), message.size()));
+
+   // Act
+   bool when_full = target->try_send(message.data(), message.size());
+   bool too_large = target->try_send(message.data(), target->max_message_size() + 1U);
+   (void)peer_engine->poll(0ns);
+   bool when_drained = target->try_send(message.data(), message.size());
+
+   // Assert
+   ASSERT_FALSE(when_full);
+   ASSERT_FALSE(too_large);
+   ASSERT_TRUE(when_drained);
+}
+
+
+TEST_F(shm_channel_tests, poll_should_deliver_message_that_wraps_around_the_ring_in_one_piece) {
+   // Arrange
+   auto target = create_target(4096);
+   auto peer = attach_peer(*target);
+   std::string first(target->capacity() - 64U, 'a');
+   ASSERT_TRUE(target->try_send(first.data(), first.size()));
+   (void)peer_engine->poll(0ns);
+   std::string wrapping(200U, 'b');
+   for (std::size_t i = 0U; i < wrapping.size(); ++i) {
+      wrapping[i] = static_cast<char>('a' + i % 26U);
+   }
+
+   // Act
+   ASSERT_TRUE(target->try_send(wrapping.data(), wrapping.size()));
+   (void)peer_engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(2U, peer_received.size());
+   ASSERT_EQ(wrapping, peer_received[1]);
+}
+
+
+TEST_F(shm_channel_tests, poll_given_tail_beyond_the_ring_should_report_bad_message_and_stop_reading) {
+   // Arrange
+   auto target = create_target(4096);
+   auto peer = attach_peer(*target);
+   auto *control = map_control(*target);
+   ASSERT_NE(nullptr, control);
+   ASSERT_TRUE(target->try_send("one", 3));
+   (void)peer_engine->poll(0ns);
+   control->rings[0].tail.store(control->rings[0].tail.load() + 4U * target->capacity());
+   control->rings[0].consumer_idle.store(false);
+   ::eventfd_write(target->handles()[1].handle, 1U);
+
+   // Act
+   (void)peer_engine->poll(0ns);
+   ::eventfd_write(target->handles()[1].handle, 1U);
+   (void)peer_engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ((std::vector<std::string>{"one"}), peer_received);
+   ASSERT_EQ((std::vector<std::error_code>{make_error_code(std::errc::bad_message)}), peer_errors);
+   (void)::munmap(control, sizeof(details_::shm_control));
+}
+
+
+TEST_F(shm_channel_tests, poll_given_message_size_beyond_what_was_published_should_report_bad_message) {
+   // Arrange
+   auto target = create_target(4096);
+   auto peer = attach_peer(*target);
+   auto *control = map_control(*target);
+   ASSERT_NE(nullptr, control);
+   ASSERT_TRUE(target->try_send("x", 1));
+   (void)peer_engine->poll(0ns);
+   // A header that claims the whole ring behind a tail that only publishes 16 bytes.
+   ASSERT_TRUE(target->try_send("y", 1));
+   std::uint64_t claimed = target->max_message_size();
+   void *ring = ::mmap(nullptr, target->capacity(), PROT_READ | PROT_WRITE, MAP_SHARED, target->handles()[0].handle,
+                       static_cast<off_t>(::sysconf(_SC_PAGESIZE)));
+   ASSERT_NE(MAP_FAILED, ring);
+   std::memcpy(static_cast<char *>(ring) + 16, &claimed, sizeof(claimed));
+
+   // Act
+   (void)peer_engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ((std::vector<std::string>{"x"}), peer_received);
+   ASSERT_EQ((std::vector<std::error_code>{make_error_code(std::errc::bad_message)}), peer_errors);
+   (void)::munmap(ring, target->capacity());
+   (void)::munmap(control, sizeof(details_::shm_control));
+}
+
+
+TEST_F(shm_channel_tests, channel_should_carry_messages_between_processes) {
+   // Arrange
+   auto target = create_target(4096);
+   std::vector<handed_off> handles = target->handles();
+
+   // Act
+   pid_t child = ::fork();
+   ASSERT_LE(0, child);
+   if (child == 0) {
+      // The child answers every message with its reverse.
+      struct echo {
+         void on_message(const char *message, std::size_t size, std::error_code error) {
+            (void)error;
+            std::string reply(message, size);
+            done = (reply == "quit");
+            (void)channel->try_send(std::string(reply.rbegin(), reply.rend()).data(), size);
+         }
+         channel_type *channel;
+         bool done;
+      } e{nullptr, false};
+      auto child_engine = std::make_shared<engine_type>(10);
+      channel_type peer(*child_engine, handles, channel_type::create_listener<echo, &echo::on_message>(e));
+      e.channel = &peer;
+      for (int i = 0; (i < 100) && !e.done; ++i) {
+         (void)child_engine->poll(100ms);
+      }
+      ::_exit(e.done ? 0 : 1);
+   }
+   ASSERT_TRUE(target->try_send("ping", 4));
+   ASSERT_TRUE(target->try_send("quit", 4));
+   for (int i = 0; (i < 100) && (received.size() < 2U); ++i) {
+      (void)engine->poll(100ms);
+   }
+   if (received.size() < 2U) {
+      // Something was lost; the child would be left waiting for it.
+      (void)::kill(child, SIGKILL);
+   }
+   int status = 0;
+   ASSERT_EQ(child, ::waitpid(child, &status, 0));
+
+   // Assert
+   ASSERT_EQ((std::vector<std::string>{"gnip", "tiuq"}), received);
+   ASSERT_TRUE(WIFEXITED(status));
+   ASSERT_EQ(0, WEXITSTATUS(status));
+}
+
+}
@@ -0,0 +1,150 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "spsc_channel.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+typedef spsc_channel<int> channel_type;
+
+
+struct spsc_channel_tests : ::testing::Test {
+   spsc_channel_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<event_engine<epoll_service>>(10)),
+      received()
+   {
+   }
+
+   inline std::unique_ptr<channel_type> create_target(std::size_t capacity) {
+      return std::make_unique<channel_type>(*engine, capacity,
+                                            channel_type::create_listener<spsc_channel_tests, &spsc_channel_tests::on_message>(*this));
+   }
+
+   void on_message(int &message) {
+      received.push_back(message);
+   }
+
+   std::shared_ptr<event_engine<epoll_service>> engine;
+   std::vector<int> received;
+};
+
+
+TEST_F(spsc_channel_tests, poll_should_deliver_every_message_sent_since_the_last_in_order) {
+   // Arrange
+   auto target = create_target(8);
+
+   // Act
+   for (int i = 1; i <= 3; ++i) {
+      ASSERT_TRUE(target->try_send(i));
+   }
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ((std::vector<int>{1, 2, 3}), received);
+}
+
+
+TEST_F(spsc_channel_tests, try_send_when_ring_is_full_should_fail_until_drained) {
+   // Arrange
+   auto target = create_target(3);
+   for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(target->try_send(i));
+   }
+
+   // Act
+   bool when_full = target->try_send(4);
+   (void)engine->poll(0ns);
+   bool when_drained = target->try_send(4);
+
+   // Assert
+   ASSERT_EQ(4U, target->capacity());
+   ASSERT_FALSE(when_full);
+   ASSERT_TRUE(when_drained);
+}
+
+
+TEST_F(spsc_channel_tests, poll_should_drain_at_most_a_ring_per_iteration_and_come_back_for_the_rest) {
+   // Arrange
+   struct refilling_handler {
+      void on_message(int &message) {
+         received.push_back(message);
+         if (message < 8) {
+            (void)channel->try_send(message + 4);
+         }
+      }
+
+      channel_type *channel;
+      std::vector<int> received;
+   };
+   refilling_handler handler{nullptr, {}};
+   channel_type target{*engine, 4, channel_type::create_listener<refilling_handler, &refilling_handler::on_message>(handler)};
+   handler.channel = &target;
+   for (int i = 1; i <= 4; ++i) {
+      ASSERT_TRUE(target.try_send(i));
+   }
+
+   // Act
+   (void)engine->poll(0ns);
+   auto first = handler.received.size();
+   for (int i = 0; (i < 10) && (handler.received.size() < 11U); ++i) {
+      (void)engine->poll(0ns);
+   }
+
+   // Assert
+   ASSERT_EQ(4U, first);
+   ASSERT_EQ(11U, handler.received.size());
+}
+
+
+TEST_F(spsc_channel_tests, channel_replacing_a_destroyed_one_should_still_be_woken) {
+   // Arrange
+   create_target(8).reset();
+   auto target = create_target(8);
+
+   // Act
+   ASSERT_TRUE(target->try_send(7));
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(std::vector<int>{7}, received);
+}
+
+
+TEST_F(spsc_channel_tests, messages_from_another_thread_should_all_arrive_in_order) {
+   // Arrange
+   constexpr int count = 100000;
+   auto target = create_target(64);
+
+   // Act
+   std::thread producer{[&target] {
+         for (int i = 0; i < count; ) {
+            if (target->try_send(i)) {
+               ++i;
+            }
+            else {
+               std::this_thread::yield();
+            }
+         }
+      }};
+   for (int i = 0; (i < 100000) && (received.size() < static_cast<std::size_t>(count)); ++i) {
+      (void)engine->poll(50ms);
+   }
+   producer.join();
+
+   // Assert
+   ASSERT_EQ(static_cast<std::size_t>(count), received.size());
+   for (int i = 0; i < count; ++i) {
+      ASSERT_EQ(i, received[static_cast<std::size_t>(i)]);
+   }
+}
+
+}
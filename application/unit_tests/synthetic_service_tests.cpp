@@ -0,0 +1,185 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "synthetic_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+struct testing_tag {};
+
+typedef handle<testing_tag, int, -1> testing_handle_type;
+
+constexpr native_handle_type first_handle = 1 << 20;
+constexpr std::size_t handle_count = 8U;
+
+
+struct counting_handler {
+   void on_activation(mode flags) {
+      ++activations;
+      seen = seen | flags;
+   }
+
+   int activations;
+   mode seen;
+};
+
+
+struct synthetic_service_tests : ::testing::Test {
+   synthetic_service_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<event_engine<synthetic_service>>(64)),
+      handlers(handle_count, counting_handler{0, mode::none})
+   {
+   }
+
+   inline void apply(synthetic_load load, mode interest) {
+      std::experimental::use_service<synthetic_service>(*engine).set_load(load);
+      for (std::size_t i = 0U; i < handle_count; ++i) {
+         engine->start_monitoring<counting_handler, &counting_handler::on_activation>(
+               testing_handle_type{first_handle + static_cast<int>(i)}, interest, handlers[i]);
+      }
+   }
+
+   inline int total_activations() const {
+      int result = 0;
+      for (const auto &h : handlers) {
+         result += h.activations;
+      }
+      return result;
+   }
+
+   std::shared_ptr<event_engine<synthetic_service>> engine;
+   std::vector<counting_handler> handlers;
+};
+
+
+TEST_F(synthetic_service_tests, poll_without_rate_should_deliver_a_full_batch_to_registered_handles) {
+   // Arrange
+   apply({first_handle, handle_count, 16U, 0.0, 1U, 0U, 0U, 0U, 0U, 0.0, 1U}, mode::read);
+
+   // Act
+   bool executed = engine->poll(0ns);
+
+   // Assert
+   ASSERT_TRUE(executed);
+   ASSERT_EQ(16, total_activations());
+   ASSERT_EQ(16U, std::experimental::use_service<synthetic_service>(*engine).events_delivered());
+}
+
+
+TEST_F(synthetic_service_tests, poll_should_mask_generated_flags_with_interest) {
+   // Arrange
+   apply({first_handle, handle_count, 64U, 0.0, 0U, 1U, 1U, 0U, 0U, 0.0, 2U}, mode::read);
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   for (const auto &h : handlers) {
+      ASSERT_EQ(mode::none, h.seen & mode::write);
+   }
+   ASSERT_LT(0, total_activations());
+}
+
+
+TEST_F(synthetic_service_tests, poll_should_concentrate_hot_share_on_hot_handles) {
+   // Arrange
+   apply({first_handle, handle_count, 64U, 0.0, 1U, 0U, 0U, 0U, 1U, 1.0, 3U}, mode::read);
+
+   // Act
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(64, handlers[0].activations);
+}
+
+
+TEST_F(synthetic_service_tests, stopped_registration_should_not_be_activated) {
+   // Arrange
+   apply({first_handle, 1U, 16U, 0.0, 1U, 0U, 0U, 0U, 0U, 0.0, 4U}, mode::read);
+   testing_handle_type h{first_handle};
+   engine->stop_monitoring(h);
+
+   // Act
+   bool executed = engine->poll(0ns);
+
+   // Assert
+   ASSERT_FALSE(executed);
+   ASSERT_EQ(0, handlers[0].activations);
+}
+
+
+TEST_F(synthetic_service_tests, set_load_should_keep_registrations_the_new_range_covers) {
+   // Arrange
+   apply({first_handle, handle_count, 16U, 0.0, 1U, 0U, 0U, 0U, 0U, 0.0, 6U}, mode::read);
+
+   // Act
+   std::experimental::use_service<synthetic_service>(*engine).set_load(
+         {first_handle + 2, handle_count, 64U, 0.0, 1U, 0U, 0U, 0U, 0U, 0.0, 6U});
+   (void)engine->poll(0ns);
+
+   // Assert
+   ASSERT_EQ(0, handlers[0].activations);
+   ASSERT_EQ(0, handlers[1].activations);
+   ASSERT_LT(0, handlers[2].activations);
+   ASSERT_LT(0, handlers[handle_count - 1U].activations);
+}
+
+
+TEST_F(synthetic_service_tests, run_without_load_should_sleep_for_its_timeout) {
+   // Arrange
+   auto cpu_time = [] {
+      ::timespec now{};
+      (void)::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+      return std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec};
+   };
+   auto before = cpu_time();
+
+   // Act
+   auto error = engine->run(200ms);
+
+   // Assert
+   ASSERT_EQ(std::make_error_code(std::errc::timed_out), error);
+   ASSERT_GT(std::chrono::nanoseconds{50ms}, cpu_time() - before);
+   ASSERT_EQ(0, total_activations());
+}
+
+
+TEST_F(synthetic_service_tests, run_without_load_should_block_until_quit) {
+   // Arrange
+   auto running = std::async(std::launch::async, [this] { return engine->run(); });
+   while (!engine->polling()) {
+      std::this_thread::yield();
+   }
+
+   // Act
+   engine->quit();
+
+   // Assert
+   ASSERT_EQ(std::future_status::ready, running.wait_for(5s));
+   ASSERT_EQ(std::error_code{}, running.get());
+}
+
+
+TEST_F(synthetic_service_tests, run_with_rate_should_deliver_about_that_many_events) {
+   // Arrange
+   apply({first_handle, handle_count, 16U, 1000.0, 1U, 0U, 0U, 0U, 0U, 0.0, 5U}, mode::read);
+
+   // Act
+   (void)engine->run(100ms);
+
+   // Assert
+   ASSERT_LE(50, total_activations());
+   ASSERT_GE(150, total_activations());
+}
+
+}
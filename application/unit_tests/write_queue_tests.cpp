@@ -0,0 +1,143 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "write_queue.h"
+#include "epoll_service.h"
+#include "event_engine.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using namespace epolling;
+using namespace std::chrono_literals;
+
+typedef event_engine<epoll_service> engine_type;
+typedef write_queue<engine_type> queue_type;
+
+struct testing_tag {};
+
+
+struct write_queue_tests : ::testing::Test {
+   write_queue_tests() :
+      ::testing::Test(),
+      engine(std::make_shared<engine_type>(10)),
+      fds{-1, -1},
+      signals(),
+      target()
+   {
+      EXPECT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds));
+      int size = 4096;
+      EXPECT_EQ(0, ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)));
+      registered = fds[0];
+      engine->start_monitoring<write_queue_tests, &write_queue_tests::on_activation>(registered, mode::read, *this);
+      target = std::make_unique<queue_type>(*engine, fds[0], mode::read, 16U * 1024U, 64U * 1024U,
+                                            queue_type::create_listener<write_queue_tests, &write_queue_tests::on_backpressure>(*this));
+   }
+
+   virtual ~write_queue_tests() override {
+      target.reset();
+      engine->stop_monitoring(registered);
+      engine.reset();
+      (void)::close(fds[0]);
+      (void)::close(fds[1]);
+   }
+
+   inline std::string read_peer() {
+      std::string result;
+      char buffer[65536];
+      ssize_t n = 0;
+      while ((n = ::read(fds[1], buffer, sizeof(buffer))) > 0) {
+         result.append(buffer, static_cast<std::size_t>(n));
+      }
+      return result;
+   }
+
+   void on_activation(mode flags) {
+      if ((flags & mode::write) != mode::none) {
+         (void)target->on_writable();
+      }
+   }
+
+   void on_backpressure(queue_type::backpressure b) {
+      signals.push_back(b);
+   }
+
+   std::shared_ptr<engine_type> engine;
+   int fds[2];
+   handle<testing_tag, int, -1> registered;
+   std::vector<queue_type::backpressure> signals;
+   std::unique_ptr<queue_type> target;
+};
+
+
+TEST_F(write_queue_tests, flush_should_write_queued_messages_in_order) {
+   // Arrange
+   target->enqueue("hello, ", 7U);
+   target->enqueue(queue_type::message_type{'w', 'o', 'r', 'l', 'd'});
+
+   // Act
+   auto error = target->flush();
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_TRUE(target->empty());
+   ASSERT_EQ("hello, world", read_peer());
+}
+
+
+TEST_F(write_queue_tests, enqueue_should_not_write_before_flush) {
+   // Act
+   target->enqueue("queued", 6U);
+
+   // Assert
+   ASSERT_EQ("", read_peer());
+   ASSERT_EQ(6U, target->queued());
+}
+
+
+TEST_F(write_queue_tests, crossing_watermarks_should_pause_then_resume_producer) {
+   // Arrange
+   std::string expected;
+   for (int i = 0; i < 100; ++i) {
+      std::string message(1024U, static_cast<char>('a' + i % 26));
+      expected += message;
+      target->enqueue(message.data(), message.size());
+   }
+
+   // Act
+   auto error = target->flush();
+   bool backed_up = !target->empty();
+   std::string actual;
+   for (int i = 0; (i < 1000) && (actual.size() < expected.size()); ++i) {
+      actual += read_peer();
+      (void)engine->poll(1ms);
+   }
+
+   // Assert
+   ASSERT_EQ(std::error_code{}, error);
+   ASSERT_TRUE(backed_up);
+   ASSERT_EQ(expected, actual);
+   ASSERT_TRUE(target->empty());
+   ASSERT_EQ((std::vector<queue_type::backpressure>{queue_type::backpressure::pause, queue_type::backpressure::resume}), signals);
+}
+
+
+TEST_F(write_queue_tests, flush_when_peer_is_gone_should_report_error_and_keep_data) {
+   // Arrange
+   (void)::close(fds[1]);
+   fds[1] = -1;
+   target->enqueue("lost", 4U);
+
+   // Act
+   auto error = target->flush();
+
+   // Assert
+   ASSERT_EQ(std::make_error_code(std::errc::broken_pipe), error);
+   ASSERT_EQ(4U, target->queued());
+}
+
+}
@@ -4,54 +4,97 @@
 
 #include "handle.h"
 #include <cassert>
+#include <cstdint>
 #include <map>
 #include <mutex>
+#include <utility>
 
 namespace epolling {
 
 template<class Signature> struct basic_activation;
-template<class Signature, class NativeHandleType, class Table=std::map<NativeHandleType, basic_activation<Signature>>, class Mutex=std::mutex> class basic_activation_store;
+template<class Signature> struct activation_traits;
+template<class Signature, class NativeHandleType, class Table=std::map<NativeHandleType, typename activation_traits<Signature>::activation_type>, class Mutex=std::mutex> class basic_activation_store;
+
+namespace details_ {
+
+// Member function templates of a local class have no linkage, so the trampoline lives at namespace scope to be
+// usable as a template argument.
+template<class Signature, class T, Signature T::*OnActivation, class U> struct trampoline;
+
+template<class R, class ... Args, class T, R (T::*OnActivation)(Args...), class U>
+struct trampoline<R(Args...), T, OnActivation, U> final {
+   static inline R jump(void *pointer, Args ... args) {
+      assert(pointer != nullptr);
+      U *object = static_cast<U*>(pointer);
+      return (object->*OnActivation)(args...);
+   }
+};
+
+}
+
 
 template<class R, class ... Args>
 struct basic_activation<R(Args...)> final {
    typedef R (*callback_type)(void *, Args...);
    typedef R result_type;
+   template<class T> using member_type = R (T::*)(Args...);
 
    callback_type callback;
    void *object;
 
+   template<class T, member_type<T> OnActivation, class U>
+   static inline basic_activation create(U &object) noexcept {
+      return create<&details_::trampoline<R(Args...), T, OnActivation, U>::jump>(&object);
+   }
+
+   template<callback_type OnActivation>
+   static inline basic_activation create(void *object=nullptr) noexcept {
+      return {OnActivation, object};
+   }
+
    inline R execute(Args && ... args) {
       using std::forward;
 
       assert(callback != nullptr);
       return (*callback)(object, forward<Args>(args)...);
    }
+
+   // Equal for activations that run the same code, whatever object they run it on.
+   inline std::uintptr_t dispatch_key() const noexcept {
+      return reinterpret_cast<std::uintptr_t>(callback);
+   }
+
+   // The object activations are delivered to.
+   inline const void *target() const noexcept {
+      return object;
+   }
 };
 
 
-template<class R, class ... Args, class NativeHandleType, class Table, class Mutex>
-class basic_activation_store<R(Args...), NativeHandleType, Table, Mutex> final {
-public:
+// Maps what a store was declared with onto the activation it holds: a plain signature selects basic_activation,
+// while an activation type (such as basic_static_activation) stands for itself.
+template<class R, class ... Args>
+struct activation_traits<R(Args...)> {
    using activation_type = basic_activation<R(Args...)>;
-   using callback_type = typename activation_type::callback_type;
+};
+
+
+template<class Signature>
+struct activation_traits<basic_activation<Signature>> {
+   using activation_type = basic_activation<Signature>;
+};
+
+
+template<class Signature, class NativeHandleType, class Table, class Mutex>
+class basic_activation_store final {
+public:
+   using activation_type = typename activation_traits<Signature>::activation_type;
    using size_type = typename Table::size_type;
+   template<class T> using member_type = typename activation_type::template member_type<T>;
 
-   template<class T, R (T::*OnActivation)(Args...), class U>
+   template<class T, member_type<T> OnActivation, class U>
    static inline activation_type create_activation(U &object) noexcept {
-      struct trampoline final {
-         static inline R jump(void *pointer, Args ... args) {
-            assert(pointer != nullptr);
-            U *object = static_cast<U*>(pointer);
-            return (object->*OnActivation)(args...);
-         }
-      };
-
-      return create_activation<&trampoline::jump>(&object);
-   }
-
-   template<callback_type OnActivation>
-   static inline activation_type create_activation(void *object=nullptr) noexcept {
-      return {OnActivation, object};
+      return activation_type::template create<T, OnActivation>(object);
    }
 
    // NOTE: An activation must be associated for h.  Otherwise, behavior is undefined.
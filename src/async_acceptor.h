@@ -0,0 +1,103 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_ASYNC_ACCEPTOR_H__
+#define EPOLLING_ASYNC_ACCEPTOR_H__
+
+#include "activation.h"
+#include "handle.h"
+#include "mode.h"
+#include <cerrno>
+#include <sys/socket.h>
+#include <system_error>
+#include <vector>
+
+namespace epolling {
+
+// Accepts connections from a non-blocking listening socket in batches.  Each readiness edge drains the listen
+// queue with accept4() up to a per-iteration budget and hands every accepted descriptor to the listener in one
+// call; the descriptors belong to the listener from then on.  When the budget runs out before the queue does,
+// the registration is rescanned so that the remainder is picked up on the next iteration; it stays edge
+// triggered otherwise, so a batch that empties the queue costs no system call beyond the accepts.
+//
+// A listener that is handed an error (EMFILE, ENFILE, ENOBUFS, ...) should call resume() once it has made room;
+// until then no further connections are accepted.
+template<class EventEngine>
+class async_acceptor final {
+   struct tag {};
+
+public:
+   typedef handle<tag, int, -1> handle_type;
+   typedef std::vector<native_handle_type> batch_type;
+   typedef basic_activation<void(batch_type &, std::error_code)> listener_type;
+
+   template<class T, void (T::*OnAccept)(batch_type &, std::error_code), class U>
+   static inline listener_type create_listener(U &object) noexcept {
+      return listener_type::template create<T, OnAccept>(object);
+   }
+
+   inline async_acceptor(EventEngine &e, native_handle_type listening_socket, std::size_t budget_per_iteration,
+                         listener_type l, mode flags=mode::read) :
+      engine(e),
+      listening(listening_socket),
+      budget(budget_per_iteration),
+      batch(),
+      listener(l)
+   {
+      batch.reserve(budget);
+      engine.template start_monitoring<async_acceptor, &async_acceptor::on_activation>(listening, flags, *this);
+   }
+
+   async_acceptor() = delete;
+   async_acceptor(const async_acceptor &) = delete;
+   async_acceptor & operator =(const async_acceptor &) = delete;
+
+   inline ~async_acceptor() noexcept {
+      engine.stop_monitoring(listening);
+   }
+
+   inline void resume() {
+      engine.rescan(listening);
+   }
+
+private:
+   void on_activation(mode activation_flags) {
+      using std::make_error_code;
+      using std::move;
+
+      (void)activation_flags;
+
+      std::error_code error;
+      batch.clear();
+      while (batch.size() < budget) {
+         int fd = ::accept4(listening, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+         if (fd >= 0) {
+            batch.push_back(fd);
+         }
+         else if ((errno != EINTR) && (errno != ECONNABORTED)) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+               error = make_error_code(static_cast<std::errc>(errno));
+            }
+            break;
+         }
+      }
+
+      bool budget_exhausted = (batch.size() == budget);
+      if (!batch.empty() || error) {
+         listener.execute(batch, move(error));
+      }
+      batch.clear();
+
+      if (budget_exhausted) {
+         resume();
+      }
+   }
+
+   EventEngine &engine;
+   handle_type listening;
+   const std::size_t budget;
+   batch_type batch;
+   listener_type listener;
+};
+
+}
+
+#endif
@@ -0,0 +1,234 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "async_process.h"
+#include "bits/exceptions.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef CLONE_PIDFD
+#  define CLONE_PIDFD 0x00001000
+#endif
+
+#ifndef P_PIDFD
+#  define P_PIDFD 3
+#endif
+
+namespace epolling {
+
+namespace details_ {
+
+namespace {
+
+// As in linux/sched.h, which does not mix with sched.h.
+struct clone_args {
+   std::uint64_t flags;
+   std::uint64_t pidfd;
+   std::uint64_t child_tid;
+   std::uint64_t parent_tid;
+   std::uint64_t exit_signal;
+   std::uint64_t stack;
+   std::uint64_t stack_size;
+   std::uint64_t tls;
+};
+
+
+struct pipe_ends {
+   int read;
+   int write;
+};
+
+
+class child_setup final {
+public:
+   child_setup() :
+      pipes{{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}}
+   {
+   }
+
+   child_setup(const child_setup &) = delete;
+   child_setup & operator =(const child_setup &) = delete;
+
+   ~child_setup() noexcept {
+      for (pipe_ends &p : pipes) {
+         close(p.read);
+         close(p.write);
+      }
+   }
+
+   void open() {
+      for (pipe_ends &p : pipes) {
+         int fds[2] = {-1, -1};
+         (void)safe([&fds] { return ::pipe2(fds, O_CLOEXEC); }, "Failed to create child process pipe.");
+         p = {fds[0], fds[1]};
+      }
+      for (int fd : {pipes[0].write, pipes[1].read, pipes[2].read}) {
+         (void)safe([fd] { return ::fcntl(fd, F_SETFL, O_NONBLOCK); }, "Failed to make child process pipe non-blocking.");
+      }
+   }
+
+   // Only async-signal-safe calls from here on; the child of a threaded parent may find any lock taken.
+   [[noreturn]] void exec(char *const *argv) noexcept {
+      int targets[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+      int sources[3] = {pipes[0].read, pipes[1].write, pipes[2].write};
+      for (int i = 0; i < 3; ++i) {
+         if (sources[i] == targets[i]) {
+            // dup2() onto itself would leave close-on-exec set.
+            (void)::fcntl(sources[i], F_SETFD, 0);
+         }
+         else if (::dup2(sources[i], targets[i]) < 0) {
+            fail();
+         }
+      }
+
+      ::sigset_t all;
+      (void)::sigfillset(&all);
+      (void)::sigprocmask(SIG_UNBLOCK, &all, nullptr);
+
+      (void)::execvp(argv[0], argv);
+      fail();
+   }
+
+   // Waits for the child to either execute or report why it could not; 0 if it did.
+   int exec_error() noexcept {
+      close(status().write);
+      int error = 0;
+      ssize_t result = 0;
+      do {
+         result = ::read(status().read, &error, sizeof(error));
+      } while ((result < 0) && (errno == EINTR));
+      return (result == static_cast<ssize_t>(sizeof(error))) ? error : 0;
+   }
+
+   spawned_process release(int pidfd) noexcept {
+      spawned_process result{pidfd, pipes[0].write, pipes[1].read, pipes[2].read};
+      pipes[0].write = -1;
+      pipes[1].read = -1;
+      pipes[2].read = -1;
+      return result;
+   }
+
+private:
+   [[noreturn]] void fail() noexcept {
+      int error = errno;
+      (void)::write(status().write, &error, sizeof(error));
+      ::_exit(127);
+   }
+
+   inline pipe_ends &status() noexcept {
+      return pipes[3];
+   }
+
+   static void close(int &fd) noexcept {
+      if (fd != -1) {
+         (void)::close(fd);
+         fd = -1;
+      }
+   }
+
+   // Standard input, output and error, then the pipe on which a child that fails to execute reports errno.
+   pipe_ends pipes[4];
+};
+
+
+// Returns the child's pid, 0 in the child, and leaves the pidfd in pidfd.  No exit signal means that the child
+// can only be waited for with __WALL.
+long clone_with_pidfd(int &pidfd) noexcept {
+   clone_args args{CLONE_PIDFD, reinterpret_cast<std::uintptr_t>(&pidfd), 0U, 0U, 0U, 0U, 0U, 0U};
+   long pid = ::syscall(SYS_clone3, &args, sizeof(args));
+   if ((pid >= 0) || (errno != ENOSYS)) {
+      return pid;
+   }
+
+   pid = ::fork();
+   if (pid > 0) {
+      pidfd = static_cast<int>(::syscall(SYS_pidfd_open, static_cast<pid_t>(pid), 0U));
+      if (pidfd < 0) {
+         int error = errno;
+         (void)::kill(static_cast<pid_t>(pid), SIGKILL);
+         (void)::waitpid(static_cast<pid_t>(pid), nullptr, 0);
+         errno = error;
+         return -1;
+      }
+   }
+   return pid;
+}
+
+
+void wait_for(int pidfd) noexcept {
+   ::siginfo_t info{};
+   while ((::waitid(static_cast<idtype_t>(P_PIDFD), static_cast<id_t>(pidfd), &info, WEXITED | __WALL) < 0) &&
+          (errno == EINTR)) {
+   }
+}
+
+}
+
+
+spawned_process spawn_process(const std::vector<std::string> &argv) {
+   if (argv.empty()) {
+      throw std::system_error(make_error_code(std::errc::invalid_argument), "No program to spawn.");
+   }
+
+   std::vector<char*> arguments;
+   arguments.reserve(argv.size() + 1U);
+   for (const std::string &argument : argv) {
+      arguments.push_back(const_cast<char*>(argument.c_str()));
+   }
+   arguments.push_back(nullptr);
+
+   child_setup setup;
+   setup.open();
+
+   int pidfd = -1;
+   long pid = clone_with_pidfd(pidfd);
+   if (pid < 0) {
+      throw std::system_error(make_error_code(static_cast<std::errc>(errno)), "Failed to spawn child process.");
+   }
+   if (pid == 0) {
+      setup.exec(arguments.data());
+   }
+
+   int error = setup.exec_error();
+   if (error != 0) {
+      wait_for(pidfd);
+      (void)::close(pidfd);
+      throw std::system_error(make_error_code(static_cast<std::errc>(error)), "Failed to execute " + argv.front() + ".");
+   }
+   return setup.release(pidfd);
+}
+
+
+bool reap_process(native_handle_type pidfd, process_exit &exit, std::error_code &ec) noexcept {
+   ::siginfo_t info{};
+   (void)safe([pidfd, &info] {
+         return ::waitid(static_cast<idtype_t>(P_PIDFD), static_cast<id_t>(pidfd), &info, WEXITED | WNOHANG | __WALL);
+      }, ec);
+   if (ec || (info.si_pid == 0)) {
+      return false;
+   }
+   exit = process_exit{info.si_code != CLD_EXITED, info.si_status};
+   return true;
+}
+
+
+void kill_process(native_handle_type pidfd) noexcept {
+   (void)signal_process(pidfd, SIGKILL);
+   wait_for(pidfd);
+}
+
+
+std::error_code signal_process(native_handle_type pidfd, int signum) noexcept {
+   std::error_code ec;
+   (void)safe([pidfd, signum] {
+         return static_cast<int>(::syscall(SYS_pidfd_send_signal, pidfd, signum, nullptr, 0U));
+      }, ec);
+   return ec;
+}
+
+}
+
+}
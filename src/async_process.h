@@ -0,0 +1,170 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_ASYNC_PROCESS_H__
+#define EPOLLING_ASYNC_PROCESS_H__
+
+#include "activation.h"
+#include "handle.h"
+#include "mode.h"
+#include "unique_handle.h"
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace epolling {
+
+// How a child ended: with exit status if it exited, or with the number of the signal that killed it.
+struct process_exit {
+   bool signalled;
+   int status;
+};
+
+
+namespace details_ {
+
+struct spawned_process {
+   native_handle_type pidfd;
+   native_handle_type input;
+   native_handle_type output;
+   native_handle_type error;
+};
+
+
+// Starts argv[0], looked up in PATH, with its standard input, output and error connected to pipes whose parent
+// ends are returned non-blocking.  Throws std::system_error, also when the program could not be executed.
+spawned_process spawn_process(const std::vector<std::string> &argv);
+
+// Reaps the child if it has ended; false with no error while it is still running.
+bool reap_process(native_handle_type pidfd, process_exit &exit, std::error_code &ec) noexcept;
+
+// Kills the child and waits for it, for children that are abandoned while still running.
+void kill_process(native_handle_type pidfd) noexcept;
+
+std::error_code signal_process(native_handle_type pidfd, int signum) noexcept;
+
+}
+
+
+// A child process supervised from the engine's polling thread.  The child is created with clone3() and
+// CLONE_PIDFD, and asks for no exit signal, so nothing about it reaches a SIGCHLD handler; its exit is noticed
+// when its pidfd becomes readable and collected with waitid(P_PIDFD), after which the listener is told how it
+// ended.  The pipes to its standard streams are non-blocking and left to the owner to monitor with the same
+// engine, so any number of children costs neither a thread nor a poll of its own.  Where clone3() is not
+// available the child is forked, and a pidfd opened for it, instead; it then does raise SIGCHLD.
+//
+// A process that is destroyed before its child has ended kills the child and waits for it.
+template<class EventEngine>
+class async_process final {
+   struct pidfd_tag {};
+   struct pipe_tag {};
+
+public:
+   typedef handle<pidfd_tag, int, -1> pidfd_type;
+   typedef basic_activation<void(process_exit, std::error_code)> listener_type;
+
+   template<class T, void (T::*OnExit)(process_exit, std::error_code), class U>
+   static inline listener_type create_listener(U &object) noexcept {
+      return listener_type::template create<T, OnExit>(object);
+   }
+
+   // Throws std::system_error.
+   async_process(EventEngine &e, const std::vector<std::string> &argv, listener_type l);
+   async_process() = delete;
+   async_process(const async_process &) = delete;
+   async_process & operator =(const async_process &) = delete;
+
+   ~async_process() noexcept;
+
+   // The parent's ends of the child's standard streams; invalid once closed.
+   inline native_handle_type input() const noexcept {
+      return stdin_pipe.get_handle();
+   }
+
+   inline native_handle_type output() const noexcept {
+      return stdout_pipe.get_handle();
+   }
+
+   inline native_handle_type error_output() const noexcept {
+      return stderr_pipe.get_handle();
+   }
+
+   // Lets the child read end of file.  Stop monitoring the handle first.
+   inline void close_input() noexcept {
+      stdin_pipe.reset();
+   }
+
+   inline bool running() const noexcept {
+      return !reaped;
+   }
+
+   inline std::error_code kill(int signum) noexcept {
+      return reaped ? std::make_error_code(std::errc::no_such_process) : details_::signal_process(pidfd.get_handle(), signum);
+   }
+
+private:
+   typedef handle<pipe_tag, int, -1> pipe_type;
+
+   void on_activation(mode activation_flags);
+
+   EventEngine &engine;
+   listener_type listener;
+   bool reaped;
+   unique_handle<pidfd_type, int (*)(int)> pidfd;
+   unique_handle<pipe_type, int (*)(int)> stdin_pipe;
+   unique_handle<pipe_type, int (*)(int)> stdout_pipe;
+   unique_handle<pipe_type, int (*)(int)> stderr_pipe;
+};
+
+
+template<class EventEngine>
+inline async_process<EventEngine>::async_process(EventEngine &e, const std::vector<std::string> &argv, listener_type l) :
+   engine(e),
+   listener(l),
+   reaped(false),
+   pidfd({}, &::close),
+   stdin_pipe({}, &::close),
+   stdout_pipe({}, &::close),
+   stderr_pipe({}, &::close)
+{
+   details_::spawned_process child = details_::spawn_process(argv);
+   pidfd.reset(pidfd_type{child.pidfd});
+   stdin_pipe.reset(pipe_type{child.input});
+   stdout_pipe.reset(pipe_type{child.output});
+   stderr_pipe.reset(pipe_type{child.error});
+   engine.template start_monitoring<async_process, &async_process::on_activation>(pidfd.get_handle(), mode::read, *this);
+}
+
+
+template<class EventEngine>
+inline async_process<EventEngine>::~async_process() noexcept {
+   pidfd_type h{pidfd.get_handle()};
+   if (!reaped) {
+      engine.stop_monitoring(h);
+      details_::kill_process(h);
+   }
+}
+
+
+template<class EventEngine>
+inline void async_process<EventEngine>::on_activation(mode activation_flags) {
+   using std::move;
+
+   (void)activation_flags;
+
+   process_exit exit{false, 0};
+   std::error_code error;
+   if (!details_::reap_process(pidfd.get_handle(), exit, error) && !error) {
+      return;
+   }
+
+   reaped = true;
+   pidfd_type h{pidfd.get_handle()};
+   engine.stop_monitoring(h);
+   // The listener may well destroy this process.
+   listener.execute(move(exit), move(error));
+}
+
+}
+
+#endif
@@ -0,0 +1,99 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_CHUNKED_TABLE_H__
+#define EPOLLING_CHUNKED_TABLE_H__
+
+#include "../numa.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace epolling {
+
+namespace details_ {
+
+// A table indexed by small integers that grows a chunk at a time and never moves what it holds, so lookups need
+// no lock while another thread is growing it.  Growing, and moving the table to another NUMA node, must be
+// serialized by the owner.
+template<class T, std::size_t ChunkSize=1024U, std::size_t MaxChunks=4096U>
+class chunked_table final {
+public:
+   typedef T value_type;
+   typedef std::uint32_t index_type;
+
+   constexpr static std::size_t max_size = ChunkSize * MaxChunks;
+
+   chunked_table() noexcept :
+      chunks(),
+      numa_node(any_numa_node)
+   {
+      for (auto &c : chunks) {
+         c.store(nullptr, std::memory_order_relaxed);
+      }
+   }
+
+   chunked_table(const chunked_table &) = delete;
+   chunked_table & operator =(const chunked_table &) = delete;
+
+   ~chunked_table() noexcept {
+      for (auto &c : chunks) {
+         T *chunk = c.load(std::memory_order_relaxed);
+         if (chunk != nullptr) {
+            for (std::size_t i = 0; i < ChunkSize; ++i) {
+               chunk[i].~T();
+            }
+            deallocate_on_numa_node(chunk, chunk_bytes);
+         }
+      }
+   }
+
+   // Returns nullptr if index has never been reserved.
+   inline T *find(std::size_t index) const noexcept {
+      if (index >= max_size) {
+         return nullptr;
+      }
+      T *chunk = chunks[index / ChunkSize].load(std::memory_order_acquire);
+      return (chunk != nullptr) ? &chunk[index % ChunkSize] : nullptr;
+   }
+
+   // Returns nullptr if index is beyond what the table can hold.  Throws std::bad_alloc.
+   inline T *reserve(std::size_t index) {
+      if (index >= max_size) {
+         return nullptr;
+      }
+      auto &c = chunks[index / ChunkSize];
+      T *chunk = c.load(std::memory_order_acquire);
+      if (chunk == nullptr) {
+         chunk = static_cast<T*>(allocate_on_numa_node(chunk_bytes, numa_node));
+         for (std::size_t i = 0; i < ChunkSize; ++i) {
+            new (&chunk[i]) T();
+         }
+         c.store(chunk, std::memory_order_release);
+      }
+      return &chunk[index % ChunkSize];
+   }
+
+   // Chunks allocated from now on are placed on node, and those already allocated are migrated there.
+   inline void place(int node) noexcept {
+      numa_node = node;
+      if (node != any_numa_node) {
+         for (auto &c : chunks) {
+            T *chunk = c.load(std::memory_order_relaxed);
+            if (chunk != nullptr) {
+               (void)move_to_numa_node(chunk, chunk_bytes, node);
+            }
+         }
+      }
+   }
+
+private:
+   constexpr static std::size_t chunk_bytes = ChunkSize * sizeof(T);
+
+   std::atomic<T*> chunks[MaxChunks];
+   int numa_node;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,111 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_EPOCH_H__
+#define EPOLLING_EPOCH_H__
+
+#include "futex.h"
+#include <atomic>
+#include <cstdint>
+
+namespace epolling {
+
+namespace details_ {
+
+// Epoch based reclamation.  Readers pin the current epoch for the length of a critical section and writers tag
+// whatever they retire with the epoch at the time.  The epoch only moves on once nobody is left pinned in the one
+// before it, so two counters are enough, and something retired in epoch e can no longer be seen by any reader
+// once the epoch has reached e + 2.
+//
+// Every operation is sequentially consistent: a writer that unpublishes something and then reads the epoch must
+// be ordered against a reader that pins an epoch and then looks for it.  The reader counts are futex words, so
+// that a writer waiting in synchronize() sleeps until the last reader leaves rather than spinning.
+class epoch_domain final {
+public:
+   typedef std::uint64_t epoch_type;
+
+   constexpr epoch_domain() noexcept :
+      global(0U),
+      even_readers(0),
+      odd_readers(0)
+   {
+   }
+
+   epoch_domain(const epoch_domain &) = delete;
+   epoch_domain & operator =(const epoch_domain &) = delete;
+
+   inline epoch_type enter() noexcept {
+      for (;;) {
+         epoch_type e = global.load();
+         (void)readers(e).fetch_add(1);
+         if (global.load() == e) {
+            return e;
+         }
+         (void)readers(e).fetch_sub(1);
+      }
+   }
+
+   inline void leave(epoch_type e) noexcept {
+      (void)readers(e).fetch_sub(1);
+   }
+
+   inline epoch_type current() const noexcept {
+      return global.load();
+   }
+
+   // Moves the epoch on if the previous one has drained, and returns the epoch in effect afterwards.
+   inline epoch_type try_advance() noexcept {
+      epoch_type e = global.load();
+      if (readers(e + 1U).load() == 0) {
+         (void)global.compare_exchange_strong(e, e + 1U);
+      }
+      return global.load();
+   }
+
+   // Returns once every reader that was pinned when it was called has left, moving the epoch on twice.  Must not
+   // be called by a reader.
+   inline void synchronize() noexcept {
+      epoch_type target = global.load() + 2U;
+      for (epoch_type e = try_advance(); e < target; e = try_advance()) {
+         readers(e + 1U).wait_while([](std::int32_t pinned) { return pinned != 0; });
+      }
+   }
+
+   static constexpr inline bool reclaimable(epoch_type retired, epoch_type now) noexcept {
+      return now >= retired + 2U;
+   }
+
+private:
+   inline futex_word &readers(epoch_type e) noexcept {
+      return ((e & 1U) != 0U) ? odd_readers : even_readers;
+   }
+
+   std::atomic<epoch_type> global;
+   futex_word even_readers;
+   futex_word odd_readers;
+};
+
+
+class epoch_guard final {
+public:
+   explicit inline epoch_guard(epoch_domain &d) noexcept :
+      domain(d),
+      pinned(d.enter())
+   {
+   }
+
+   epoch_guard(const epoch_guard &) = delete;
+   epoch_guard & operator =(const epoch_guard &) = delete;
+
+   inline ~epoch_guard() noexcept {
+      domain.leave(pinned);
+   }
+
+private:
+   epoch_domain &domain;
+   epoch_domain::epoch_type pinned;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_FUTEX_H__
+#define EPOLLING_FUTEX_H__
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace epolling {
+
+namespace details_ {
+
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_ia32_pause();
+#elif defined(__aarch64__)
+   asm volatile("yield" ::: "memory");
+#endif
+}
+
+
+// A 32-bit atomic that other threads can sleep on until its value changes.  Waiters spin briefly before going to
+// sleep in the kernel, and writers only pay for a wake-up system call when somebody is actually asleep.
+class futex_word final {
+public:
+   constexpr static int spin_limit = 128;
+
+   constexpr explicit inline futex_word(std::int32_t v) noexcept :
+      value(v),
+      sleepers(0)
+   {
+   }
+
+   futex_word(const futex_word &) = delete;
+   futex_word & operator =(const futex_word &) = delete;
+
+   inline std::int32_t load(std::memory_order order=std::memory_order_seq_cst) const noexcept {
+      return value.load(order);
+   }
+
+   inline void store(std::int32_t v) noexcept {
+      value.store(v);
+      wake();
+   }
+
+   inline std::int32_t fetch_add(std::int32_t v) noexcept {
+      std::int32_t result = value.fetch_add(v);
+      wake();
+      return result;
+   }
+
+   inline std::int32_t fetch_sub(std::int32_t v) noexcept {
+      std::int32_t result = value.fetch_sub(v);
+      wake();
+      return result;
+   }
+
+   template<class Predicate>
+   inline void wait_while(Predicate keep_waiting) noexcept {
+      for (int spins = 0; spins < spin_limit; ++spins) {
+         if (!keep_waiting(load())) {
+            return;
+         }
+         cpu_relax();
+      }
+
+      // Both sides use sequentially consistent operations: either the writer sees the sleeper and wakes it, or
+      // the sleeper sees the new value.  FUTEX_WAIT itself rechecks the value before sleeping.
+      sleepers.fetch_add(1);
+      for (std::int32_t current = load(); keep_waiting(current); current = load()) {
+         (void)::syscall(SYS_futex, address(), FUTEX_WAIT_PRIVATE, current, nullptr, nullptr, 0);
+      }
+      sleepers.fetch_sub(1);
+   }
+
+private:
+   static_assert(sizeof(std::atomic<std::int32_t>) == sizeof(std::int32_t),
+                 "futex_word requires std::atomic<int32_t> to be a plain 32-bit word.");
+
+   inline std::int32_t * address() noexcept {
+      return reinterpret_cast<std::int32_t *>(&value);
+   }
+
+   inline void wake() noexcept {
+      if (sleepers.load() > 0) {
+         (void)::syscall(SYS_futex, address(), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+      }
+   }
+
+   std::atomic<std::int32_t> value;
+   std::atomic<std::int32_t> sleepers;
+};
+
+}
+
+}
+
+#endif
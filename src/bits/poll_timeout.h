@@ -0,0 +1,30 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_POLL_TIMEOUT_H__
+#define EPOLLING_POLL_TIMEOUT_H__
+
+#include <chrono>
+#include <limits>
+
+namespace epolling {
+
+namespace details_ {
+
+// A negative timeout waits for ever.  Anything else is rounded up to the millisecond poll() and epoll count in,
+// so that neither waiting for ever nor a wait shorter than a millisecond turns into polling without blocking.
+inline int to_poll_timeout(std::chrono::nanoseconds timeout) noexcept {
+   using std::chrono::duration_cast;
+   using std::chrono::milliseconds;
+
+   if (timeout < std::chrono::nanoseconds{0}) {
+      return -1;
+   }
+   auto whole = duration_cast<milliseconds>(timeout);
+   auto rounded = whole.count() + ((whole < timeout) ? 1 : 0);
+   return (rounded > std::numeric_limits<int>::max()) ? std::numeric_limits<int>::max() : static_cast<int>(rounded);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,37 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_SIMULATED_REGISTRATION_H__
+#define EPOLLING_SIMULATED_REGISTRATION_H__
+
+#include "../mode.h"
+#include <atomic>
+#include <utility>
+
+namespace epolling {
+
+namespace details_ {
+
+// A registration with an EventService that makes readiness up rather than asking the kernel.  Being stopped is
+// a flag, so that it can happen from any thread while the service dispatches.
+template<class Activation>
+struct simulated_registration {
+   Activation activation{};
+   mode interest{mode::none};
+   std::atomic<bool> registered{false};
+
+   // Hands flags to the handler, less what it did not ask for; hangup and error always get through, as they do
+   // with epoll.  False if there was nothing to hand over.
+   inline bool fire(mode flags) {
+      mode wanted = flags & (interest | mode::hangup | mode::error);
+      if (!registered.load(std::memory_order_acquire) || (wanted == mode::none)) {
+         return false;
+      }
+      activation.execute(std::move(wanted));
+      return true;
+   }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,34 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "buffer_pool.h"
+
+namespace epolling {
+
+namespace {
+
+constexpr inline std::size_t round_up(std::size_t size, std::size_t alignment) noexcept {
+   return (size + alignment - 1U) / alignment * alignment;
+}
+
+}
+
+
+buffer_pool::buffer_pool(std::size_t buffer_size, std::size_t count, int node) :
+   size_of_buffer(round_up(buffer_size, alignment)),
+   region_size(size_of_buffer * count),
+   numa_node(node),
+   region((region_size > 0U) ? static_cast<char*>(allocate_on_numa_node(region_size, node)) : nullptr),
+   free_buffers()
+{
+   free_buffers.reserve(count);
+   // Handed out from the start of the region first.
+   for (std::size_t i = count; i > 0U; --i) {
+      free_buffers.push_back(region + (i - 1U) * size_of_buffer);
+   }
+}
+
+
+buffer_pool::~buffer_pool() noexcept {
+   deallocate_on_numa_node(region, region_size);
+}
+
+}
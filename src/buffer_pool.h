@@ -0,0 +1,62 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_BUFFER_POOL_H__
+#define EPOLLING_BUFFER_POOL_H__
+
+#include "numa.h"
+#include <cstddef>
+#include <vector>
+
+namespace epolling {
+
+// Fixed-size buffers carved out of a single region placed on one NUMA node, by default that of the thread
+// creating the pool.  An engine bound to a node keeps its own pool there, so connection buffers are as local to
+// its polling thread as its registrations are.  Not thread safe: a pool belongs to the thread that polls.
+class buffer_pool final {
+public:
+   constexpr static std::size_t alignment = 64U;
+
+   buffer_pool(std::size_t buffer_size, std::size_t count, int node=current_numa_node());
+   buffer_pool() = delete;
+   buffer_pool(const buffer_pool &) = delete;
+   buffer_pool & operator =(const buffer_pool &) = delete;
+
+   ~buffer_pool() noexcept;
+
+   // Returns nullptr once every buffer is in use.
+   inline void *acquire() noexcept {
+      if (free_buffers.empty()) {
+         return nullptr;
+      }
+      void *result = free_buffers.back();
+      free_buffers.pop_back();
+      return result;
+   }
+
+   // NOTE: buffer must have come from this pool's acquire().
+   inline void release(void *buffer) noexcept {
+      free_buffers.push_back(static_cast<char*>(buffer));
+   }
+
+   inline std::size_t buffer_size() const noexcept {
+      return size_of_buffer;
+   }
+
+   inline std::size_t available() const noexcept {
+      return free_buffers.size();
+   }
+
+   inline int node() const noexcept {
+      return numa_node;
+   }
+
+private:
+   const std::size_t size_of_buffer;
+   const std::size_t region_size;
+   const int numa_node;
+   char *region;
+   std::vector<char*> free_buffers;
+};
+
+}
+
+#endif
@@ -3,20 +3,64 @@
 #define EPOLLING_EPOLL_SERVICE_H__
 
 #include "activation.h"
+#include "inline_activation.h"
 #include "mode.h"
+#include "notification.h"
+#include "numa.h"
+#include "readiness_trace.h"
+#include "bits/chunked_table.h"
+#include "bits/epoch.h"
 #include "bits/exceptions.h"
+#include "bits/poll_timeout.h"
 #include "signal_handle.h"
+#include "static_activation.h"
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <csignal>
+#include <cstdint>
 #include <experimental/executor>
+#include <mutex>
+#include <thread>
+#include <typeinfo>
 #include <sys/epoll.h>
 #include <unistd.h>
+#include <vector>
+
+#ifndef EPOLLEXCLUSIVE
+#  define EPOLLEXCLUSIVE (1U << 28)
+#endif
 
 namespace epolling {
 
 using event_activation = basic_activation<void(mode)>;
 
+template<class Activation> class basic_epoll_service;
+
+using epoll_service = basic_epoll_service<event_activation>;
+
+template<class T, void (T::*OnActivation)(mode)>
+using event_handler = activation_handler<T, void (T::*)(mode), OnActivation>;
+
+// What snapshot() reports for one registration.  handler is the type of the object activations are delivered
+// to, and last_activation is the time at which the batch that last activated it was returned by the kernel.
+struct registration_info {
+   native_handle_type handle;
+   mode interest;
+   const std::type_info *handler;
+   std::uint64_t activations;
+   std::chrono::steady_clock::time_point last_activation;
+};
+
+
+// An epoll_service dispatching to a closed set of handlers without indirect calls.  The engine's own
+// notification is always part of the set.
+template<class ... Handlers>
+using static_epoll_service = basic_epoll_service<basic_static_activation<void(mode), notification::handler_type, Handlers...>>;
+
+// An epoll_service that also registers lambdas and other small callables, held in the registration itself.
+using inline_epoll_service = basic_epoll_service<basic_inline_activation<void(mode)>>;
+
 namespace details_ {
 
 constexpr inline uint32_t set_flag(epolling::mode in_flag, epolling::mode flags, uint32_t out_flag) noexcept {
@@ -24,14 +68,25 @@ constexpr inline uint32_t set_flag(epolling::mode in_flag, epolling::mode flags,
 }
 
 
+constexpr uint32_t exclusive_flags = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLEXCLUSIVE;
+
+
+constexpr inline bool is_exclusive(epolling::mode flags) noexcept {
+   return (flags & epolling::mode::exclusive) != epolling::mode::none;
+}
+
+
+// The kernel refuses EPOLLEXCLUSIVE alongside anything other than EPOLLIN, EPOLLOUT and EPOLLET, so exclusive
+// registrations give up urgent data, hangup notification and one time delivery.
 inline uint32_t convert_flags(epolling::mode in_flags) noexcept {
    using epolling::mode;
 
-   return set_flag(mode::read, in_flags, EPOLLIN) |
-          set_flag(mode::urgent_read, in_flags, EPOLLPRI) |
-          set_flag(mode::write, in_flags, EPOLLOUT) |
-          set_flag(mode::one_time, in_flags, EPOLLONESHOT) |
-          EPOLLRDHUP | EPOLLET;
+   uint32_t result = set_flag(mode::read, in_flags, EPOLLIN) |
+                     set_flag(mode::urgent_read, in_flags, EPOLLPRI) |
+                     set_flag(mode::write, in_flags, EPOLLOUT) |
+                     set_flag(mode::one_time, in_flags, EPOLLONESHOT) |
+                     EPOLLRDHUP | EPOLLET;
+   return is_exclusive(in_flags) ? ((result | EPOLLEXCLUSIVE) & exclusive_flags) : result;
 }
 
 
@@ -40,11 +95,16 @@ inline epolling::mode set_flag(uint32_t in_flag, uint32_t flags, epolling::mode
 }
 
 
+// EPOLLHUP and EPOLLERR are reported by the kernel whether or not they were requested, and EPOLLRDHUP is always
+// requested (see above).  Passing them on lets a handler tear down a connection without first issuing a read()
+// just to observe the 0 or -1.
 inline epolling::mode convert_flags(uint32_t in_flags) noexcept {
    using epolling::mode;
    return set_flag(EPOLLIN, in_flags, mode::read) |
           set_flag(EPOLLPRI, in_flags, mode::urgent_read) |
-          set_flag(EPOLLOUT, in_flags, mode::write);
+          set_flag(EPOLLOUT, in_flags, mode::write) |
+          set_flag(EPOLLRDHUP | EPOLLHUP, in_flags, mode::hangup) |
+          set_flag(EPOLLERR, in_flags, mode::error);
 }
 
 
@@ -56,6 +116,26 @@ inline int do_poll(int epoll_fd, ::epoll_event *events, int max_events, int time
 }
 
 
+// Exclusive registrations are never one time (see convert_flags()).
+constexpr inline bool is_one_time(epolling::mode flags) noexcept {
+   return ((flags & epolling::mode::one_time) != epolling::mode::none) && !is_exclusive(flags);
+}
+
+
+constexpr inline bool is_rearmed(epolling::mode flags) noexcept {
+   return is_one_time(flags) && ((flags & epolling::mode::rearm) != epolling::mode::none);
+}
+
+
+// Whether asking again for the interest a registration already has would change nothing in the kernel.  A one time
+// registration may have been disarmed by a delivery the caller cannot know about yet, unless it re-arms itself,
+// in which case it is only disarmed until its handler returns.  Replacing an exclusive one is the only way to have
+// the kernel look at its readiness again, since it cannot be one time.
+constexpr inline bool is_unchanged(epolling::mode flags, bool armed) noexcept {
+   return is_one_time(flags) ? (is_rearmed(flags) && armed) : !is_exclusive(flags);
+}
+
+
 constexpr bool is_read(uint32_t flags) {
    return (flags & (EPOLLIN | EPOLLPRI)) > 0U;
 }
@@ -71,20 +151,61 @@ constexpr bool is_error(uint32_t flags) {
 }
 
 
-auto fire_event_callbacks = [](::epoll_event &event) {
-   auto *activation = static_cast<epolling::event_activation*>(event.data.ptr);
-   assert(activation != nullptr);
-   activation->execute(convert_flags(event.events));
-};
+// What the kernel hands back with each event: the registration's slot in the low half and the generation it
+// was registered under in the high half.
+typedef std::uint64_t registration_tag;
+
+
+constexpr inline registration_tag make_tag(std::uint32_t slot, std::uint32_t generation) noexcept {
+   return (static_cast<registration_tag>(generation) << 32U) | slot;
+}
+
+
+constexpr inline std::uint32_t slot_of(registration_tag tag) noexcept {
+   return static_cast<std::uint32_t>(tag);
+}
+
+
+constexpr inline std::uint32_t generation_of(registration_tag tag) noexcept {
+   return static_cast<std::uint32_t>(tag >> 32U);
+}
 
 }
 
 
-class epoll_service : public std::experimental::execution_context::service {
+// Registrations live in slots that are named to the kernel by a generation tagged index rather than a pointer.
+// Deregistration bumps the slot's generation, which is all it takes for an event already on its way, in the
+// kernel or in the batch being dispatched, to be recognized as stale and skipped; it takes no lock and may be
+// called from any thread, including from inside a handler.  The slot itself is only reused once every dispatch
+// that could still have been looking at it has finished, which the polling thread tracks with epochs.
+//
+// stop_monitoring() from a thread other than the polling one returns only once the batch being dispatched, if
+// any, has finished, so that a handler that was already running is done with its object by then.  A poller that
+// is only waiting for events is not disturbed.
+//
+// snapshot() may be called from any thread while the loop runs; it takes no lock the poller needs.  Each entry is
+// consistent in itself, but registrations that come and go while it runs may or may not be in it.
+//
+// The registration table and the event buffer are placed on the NUMA node of the thread that polls, as found on
+// the first poll, unless set_numa_node() says otherwise.  The event buffers belong to the service, so only one
+// thread may poll it at a time, which event_engine enforces.
+//
+// Every registration remembers the interest the kernel was last given, so update_monitoring() with what is
+// already in place costs no system call, and no longer makes the kernel report a descriptor that is still ready
+// again; a one time registration, re-armed that way, does, and rescan() always does.  A one time registration
+// also remembers whether it has fired since it was last armed; with mode::rearm the service re-arms it after its
+// handler returns.
+//
+// Each batch is decoded in full before any handler runs, and the objects handlers are delivered to are prefetched
+// a few events ahead of dispatch (see set_prefetch_distance() and set_grouped_dispatch()).
+template<class Activation>
+class basic_epoll_service : public std::experimental::execution_context::service {
 public:
+   using activation_type = Activation;
+
    constexpr static int InvalidFileDescriptor = -1;
 
-   explicit epoll_service(std::experimental::execution_context &e) :
+   explicit basic_epoll_service(std::experimental::execution_context &e) :
       std::experimental::execution_context::service(e),
       blocked_signals(),
       epoll_fd(::epoll_create1(EPOLL_CLOEXEC))
@@ -93,17 +214,43 @@ public:
            "Failed to create an empty signal set.");
    }
 
-   virtual ~epoll_service() noexcept final override {
+   virtual ~basic_epoll_service() noexcept final override {
    }
 
    template<class T, void (T::*OnActivation)(mode), class Tag, class U>
    inline auto start_monitoring(const handle<Tag, int, InvalidFileDescriptor> &fd, mode flags, U &object) noexcept {
+      return monitor(fd, flags, activation_type::template create<T, OnActivation>(object), typeid(T));
+   }
+
+   // Registers a callable that the activation holds itself; see basic_inline_activation.
+   template<class Tag, class F>
+   inline auto start_monitoring(const handle<Tag, int, InvalidFileDescriptor> &fd, mode flags, F &&callable) noexcept {
+      using std::forward;
+
+      return monitor(fd, flags, activation_type::create(forward<F>(callable)), typeid(std::decay_t<F>));
+   }
+
+   // Gives the kernel the interest the registration already has, which update_monitoring() would skip, so that a
+   // descriptor that is still ready is reported again.
+   template<class Tag>
+   inline auto rescan(const handle<Tag, int, InvalidFileDescriptor> &fd) noexcept {
       std::error_code ec;
-      safe([=, &object] {
-            event_activation &activation = activations.get(fd);
-            activation = event_activation_store::create_activation<T, OnActivation>(object);
-            epoll_event ev = {details_::convert_flags(flags), {&activation}};
-            return ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+      safe([=] {
+            auto *current = tags.find(static_cast<std::size_t>(fd));
+            details_::registration_tag tag = (current != nullptr) ? current->load(std::memory_order_acquire) : 0U;
+            if (tag == 0U) {
+               errno = ENOENT;
+               return -1;
+            }
+            registration *r = slots.find(details_::slot_of(tag));
+            mode flags = r->interest.load(std::memory_order_relaxed);
+            ::epoll_event ev{details_::convert_flags(flags), {nullptr}};
+            ev.data.u64 = tag;
+            int result = modify(fd, flags, ev);
+            if (result == 0) {
+               r->armed.store(true, std::memory_order_relaxed);
+            }
+            return result;
          }, ec);
       return ec;
    }
@@ -112,9 +259,29 @@ public:
    inline auto update_monitoring(const handle<Tag, int, InvalidFileDescriptor> &fd, mode flags) noexcept {
       std::error_code ec;
       safe([=] {
-            event_activation &activation = activations.get(fd);
-            epoll_event ev = {details_::convert_flags(flags), {&activation}};
-            return ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+            auto *current = tags.find(static_cast<std::size_t>(fd));
+            details_::registration_tag tag = (current != nullptr) ? current->load(std::memory_order_acquire) : 0U;
+            if (tag == 0U) {
+               errno = ENOENT;
+               return -1;
+            }
+            registration *r = slots.find(details_::slot_of(tag));
+            mode previous = r->interest.exchange(flags, std::memory_order_relaxed);
+            if ((previous == flags) && details_::is_unchanged(flags, r->armed.load(std::memory_order_relaxed))) {
+               return 0;
+            }
+            ::epoll_event ev{details_::convert_flags(flags), {nullptr}};
+            ev.data.u64 = tag;
+            int result = modify(fd, previous, ev);
+            if (result == 0) {
+               r->armed.store(true, std::memory_order_relaxed);
+            }
+            else {
+               int error = errno;
+               r->interest.store(previous, std::memory_order_relaxed);
+               errno = error;
+            }
+            return result;
          }, ec);
       return ec;
    }
@@ -123,26 +290,45 @@ public:
    inline auto stop_monitoring(const handle<Tag, int, InvalidFileDescriptor> &fd) noexcept {
       std::error_code ec;
       safe([=] {
-            activations.deactivate(fd);
+            if (!unpublish(fd)) {
+               errno = ENOENT;
+               return -1;
+            }
             return ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
          }, ec);
+      if ((ec != std::errc::no_such_file_or_directory) &&
+          (poller.load(std::memory_order_relaxed) != std::this_thread::get_id())) {
+         epochs.synchronize();
+      }
       return ec;
    }
 
    inline std::pair<std::error_code, bool> poll(std::size_t max_events, std::chrono::nanoseconds timeout) {
-      using std::begin;
-      using std::end;
-      using std::for_each;
       using std::make_pair;
       using std::chrono::duration_cast;
 
-      std::vector<::epoll_event> events{max_events, {0U, {nullptr}}};
-      int num_events = details_::do_poll(epoll_fd, events.data(), events.size(),
-                                         duration_cast<std::chrono::milliseconds>(timeout).count(),
+      poller.store(std::this_thread::get_id(), std::memory_order_relaxed);
+      if (!placed) {
+         set_numa_node(current_numa_node());
+      }
+      if (events.size() < max_events) {
+         event_buffer_type buffer(max_events, ::epoll_event{0U, {nullptr}}, event_buffer_type::allocator_type{numa_node});
+         events.swap(buffer);
+         pending.reserve(max_events);
+      }
+      reclaim();
+
+      int num_events = details_::do_poll(epoll_fd, events.data(), static_cast<int>(max_events),
+                                         details_::to_poll_timeout(timeout),
                                          blocked_signals);
 
       if (0 < num_events) {
-         for_each(begin(events), begin(events) + num_events, details_::fire_event_callbacks);
+         details_::epoch_guard pinned{epochs};
+         auto now = std::chrono::steady_clock::now();
+         if (recorder != nullptr) {
+            record(now, static_cast<std::size_t>(num_events));
+         }
+         dispatch(static_cast<std::size_t>(num_events), now.time_since_epoch().count());
          return make_pair(std::error_code{}, true);
       }
       else if (0 == num_events) {
@@ -156,11 +342,336 @@ public:
       return add_to_signals(blocked_signals, signum);
    }
 
+   // Logs every batch poll() returns from now on to recorder, or stops logging if it is nullptr.  Must be called
+   // from the polling thread, or while nothing polls.
+   inline void set_recorder(trace_recorder *r) noexcept {
+      recorder = r;
+   }
+
+   // How many events ahead of the one being dispatched the object it is delivered to is prefetched; 0 dispatches
+   // every event as soon as it is decoded.  Must be called from the polling thread, or while nothing polls.
+   inline void set_prefetch_distance(std::size_t distance) noexcept {
+      prefetch_distance = distance;
+   }
+
+   // Whether the events of a batch are reordered so that those going to the same handler code run back to back.
+   // Events for one registration keep their order, but the order across registrations is no longer the kernel's.
+   // Must be called from the polling thread, or while nothing polls.
+   inline void set_grouped_dispatch(bool grouped) noexcept {
+      grouped_dispatch = grouped;
+   }
+
+   std::vector<registration_info> snapshot() const {
+      using std::chrono::steady_clock;
+
+      std::vector<registration_info> result;
+      std::uint32_t count = next_slot.load(std::memory_order_acquire);
+      for (std::uint32_t slot = 0U; slot < count; ++slot) {
+         const registration *r = slots.find(slot);
+         std::uint32_t generation = r->generation.load();
+         registration_info info{r->handle.load(std::memory_order_relaxed),
+                                r->interest.load(std::memory_order_relaxed),
+                                r->handler.load(std::memory_order_relaxed),
+                                r->activations.load(std::memory_order_relaxed),
+                                steady_clock::time_point{steady_clock::duration{r->last_activation.load(std::memory_order_relaxed)}}};
+         // Only registrations that are published under the same generation before and after reading count.
+         const auto *current = tags.find(static_cast<std::size_t>(info.handle));
+         if ((current != nullptr) && (current->load() == details_::make_tag(slot, generation)) &&
+             (r->generation.load() == generation)) {
+            result.push_back(info);
+         }
+      }
+      return result;
+   }
+
+   // Must be called from the polling thread, or while nothing polls.
+   inline void set_numa_node(int node) {
+      {
+         std::lock_guard<std::mutex> l{registration_lock};
+         slots.place(node);
+         tags.place(node);
+      }
+      numa_node = node;
+      placed = true;
+      event_buffer_type buffer(events.size(), ::epoll_event{0U, {nullptr}}, event_buffer_type::allocator_type{node});
+      events.swap(buffer);
+      pending_buffer_type decoded{typename pending_buffer_type::allocator_type{node}};
+      decoded.reserve(events.size());
+      pending.swap(decoded);
+   }
+
 
 private:
    struct eventfd_tag {};
 
-   using event_activation_store = basic_activation_store<void(mode), int>;
+   using event_buffer_type = std::vector<::epoll_event, numa_allocator<::epoll_event>>;
+
+   struct registration {
+      // Never 0, so that a tag of 0 can stand for no registration.
+      std::atomic<std::uint32_t> generation{1U};
+      activation_type activation{};
+      std::uint32_t next_retired{0U};
+      details_::epoch_domain::epoch_type retired_at{0U};
+      // For snapshot(); only the polling thread counts activations, so plain loads and stores do.
+      std::atomic<native_handle_type> handle{-1};
+      // What the kernel was last told to watch for, and whether a one time registration may still fire.
+      std::atomic<mode> interest{mode::none};
+      std::atomic<bool> armed{true};
+      std::atomic<const std::type_info*> handler{nullptr};
+      std::atomic<std::uint64_t> activations{0U};
+      std::atomic<std::chrono::steady_clock::rep> last_activation{0};
+   };
+
+   // An event of the batch, decoded.  key is only filled in for grouped dispatch.
+   struct pending_event {
+      registration *target;
+      details_::registration_tag tag;
+      std::uint32_t events;
+      std::uintptr_t key;
+   };
+
+   using pending_buffer_type = std::vector<pending_event, numa_allocator<pending_event>>;
+
+   // Decodes the whole batch first, prefetching each slot as it goes, so that by the time the handlers run their
+   // activations are cached and the objects they are delivered to can be fetched a few events ahead.  Events
+   // whose registration is already gone are dropped here; the generation is checked again right before each
+   // handler runs, since an earlier handler of the same batch may stop a later registration.
+   inline void dispatch(std::size_t num_events, std::chrono::steady_clock::rep now) {
+      using std::begin;
+      using std::end;
+
+      pending.clear();
+      for (std::size_t i = 0U; i < num_events; ++i) {
+         const ::epoll_event &event = events[i];
+         registration *r = slots.find(details_::slot_of(event.data.u64));
+         if ((r != nullptr) && (r->generation.load(std::memory_order_relaxed) == details_::generation_of(event.data.u64))) {
+            __builtin_prefetch(r, 1);
+            pending.push_back({r, event.data.u64, event.events, 0U});
+         }
+      }
+
+      if (grouped_dispatch) {
+         for (pending_event &p : pending) {
+            p.key = p.target->activation.dispatch_key();
+         }
+         std::stable_sort(begin(pending), end(pending), [](const pending_event &a, const pending_event &b) {
+               return a.key < b.key;
+            });
+      }
+
+      std::size_t count = pending.size();
+      std::size_t ahead = std::min(prefetch_distance, count);
+      for (std::size_t i = 0U; i < ahead; ++i) {
+         prefetch_target(pending[i]);
+      }
+      for (std::size_t i = 0U; i < count; ++i) {
+         if ((ahead != 0U) && (i + ahead < count)) {
+            prefetch_target(pending[i + ahead]);
+         }
+         fire(pending[i], now);
+      }
+   }
+
+   // An activation that holds its callable itself has no object apart from the slot, which is fetched already.
+   static inline void prefetch_target(const pending_event &event) noexcept {
+      const void *object = event.target->activation.target();
+      if (object != nullptr) {
+         __builtin_prefetch(object);
+      }
+   }
+
+   inline void fire(const pending_event &event, std::chrono::steady_clock::rep now) {
+      registration *r = event.target;
+      std::uint32_t generation = details_::generation_of(event.tag);
+      if (r->generation.load() != generation) {
+         return;
+      }
+      r->activations.store(r->activations.load(std::memory_order_relaxed) + 1U, std::memory_order_relaxed);
+      r->last_activation.store(now, std::memory_order_relaxed);
+      bool one_time = details_::is_one_time(r->interest.load(std::memory_order_relaxed));
+      if (one_time) {
+         r->armed.store(false, std::memory_order_relaxed);
+      }
+      r->activation.execute(details_::convert_flags(event.events));
+      if (one_time) {
+         rearm(*r, event.tag);
+      }
+   }
+
+   // Re-arms a one time registration that asked for it once its handler has returned, unless the handler
+   // stopped it, re-armed it or made it something else in the meantime.  Failure leaves it disarmed; the
+   // descriptor is most likely gone, and the owner learns of it on its next update or stop.
+   inline void rearm(registration &r, details_::registration_tag tag) noexcept {
+      mode interest = r.interest.load(std::memory_order_relaxed);
+      if (!details_::is_rearmed(interest) || r.armed.load(std::memory_order_relaxed) ||
+          (r.generation.load() != details_::generation_of(tag))) {
+         return;
+      }
+      ::epoll_event ev{details_::convert_flags(interest), {nullptr}};
+      ev.data.u64 = tag;
+      if (modify(r.handle.load(std::memory_order_relaxed), interest, ev) == 0) {
+         r.armed.store(true, std::memory_order_relaxed);
+      }
+   }
+
+   inline std::error_code monitor(int fd, mode flags, const activation_type &activation, const std::type_info &handler) noexcept {
+      std::error_code ec;
+      safe([=, &activation, &handler] {
+            details_::registration_tag tag = 0U;
+            std::atomic<details_::registration_tag> *current = nullptr;
+            {
+               std::lock_guard<std::mutex> l{registration_lock};
+               current = tags.reserve(static_cast<std::size_t>(fd));
+               if (current == nullptr) {
+                  errno = EMFILE;
+                  return -1;
+               }
+               std::uint32_t slot = 0U;
+               registration *r = allocate(slot);
+               if (r == nullptr) {
+                  errno = ENOSPC;
+                  return -1;
+               }
+               r->activation = activation;
+               r->handle.store(fd, std::memory_order_relaxed);
+               r->interest.store(flags, std::memory_order_relaxed);
+               r->armed.store(true, std::memory_order_relaxed);
+               r->handler.store(&handler, std::memory_order_relaxed);
+               r->activations.store(0U, std::memory_order_relaxed);
+               r->last_activation.store(0, std::memory_order_relaxed);
+               tag = details_::make_tag(slot, r->generation.load(std::memory_order_relaxed));
+            }
+
+            ::epoll_event ev{details_::convert_flags(flags), {nullptr}};
+            ev.data.u64 = tag;
+            int result = ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+            if (result < 0) {
+               int error = errno;
+               retire(tag);
+               errno = error;
+            }
+            else {
+               // Closing a descriptor drops its registration without a word to us; whatever the table still
+               // held for fd belongs to an earlier descriptor of the same number.
+               details_::registration_tag stale = current->exchange(tag, std::memory_order_acq_rel);
+               if (stale != 0U) {
+                  retire(stale);
+               }
+            }
+            return result;
+         }, ec);
+      return ec;
+   }
+
+   // Done before dispatching, while every event in the batch can still be traced back to its handle.  Events
+   // that are already stale are recorded against handle -1.
+   inline void record(std::chrono::steady_clock::time_point now, std::size_t num_events) {
+      recorder->begin_batch(now, num_events);
+      for (std::size_t i = 0U; i < num_events; ++i) {
+         const ::epoll_event &event = events[i];
+         const registration *r = slots.find(details_::slot_of(event.data.u64));
+         bool live = (r != nullptr) && (r->generation.load() == details_::generation_of(event.data.u64));
+         recorder->add(live ? r->handle.load(std::memory_order_relaxed) : -1, details_::convert_flags(event.events));
+      }
+   }
+
+   // Must be called with registration_lock held.
+   inline registration *allocate(std::uint32_t &slot) {
+      if (!free_slots.empty()) {
+         slot = free_slots.back();
+         free_slots.pop_back();
+         return slots.find(slot);
+      }
+      std::uint32_t next = next_slot.load(std::memory_order_relaxed);
+      registration *r = slots.reserve(next);
+      if (r != nullptr) {
+         slot = next;
+         next_slot.store(next + 1U, std::memory_order_release);
+      }
+      return r;
+   }
+
+   // Detaches whatever is registered for fd and retires its slot; false if there was nothing.  Only the caller
+   // that wins the exchange touches the slot, so racing deregistrations of one handle are harmless.
+   inline bool unpublish(int fd) noexcept {
+      auto *current = tags.find(static_cast<std::size_t>(fd));
+      details_::registration_tag tag = (current != nullptr) ? current->exchange(0U) : 0U;
+      if (tag == 0U) {
+         return false;
+      }
+      retire(tag);
+      return true;
+   }
+
+   inline void retire(details_::registration_tag tag) noexcept {
+      std::uint32_t slot = details_::slot_of(tag);
+      registration &r = *slots.find(slot);
+      std::uint32_t generation = details_::generation_of(tag) + 1U;
+      r.generation.store((generation == 0U) ? 1U : generation);
+      r.retired_at = epochs.current();
+
+      std::uint32_t head = retired.load(std::memory_order_relaxed);
+      do {
+         r.next_retired = head;
+      } while (!retired.compare_exchange_weak(head, slot + 1U, std::memory_order_release, std::memory_order_relaxed));
+   }
+
+   // Runs on the polling thread between batches, when it holds no slot itself.
+   inline void reclaim() {
+      using std::begin;
+      using std::end;
+
+      if ((retired.load(std::memory_order_relaxed) == 0U) && limbo.empty()) {
+         return;
+      }
+
+      std::unique_lock<std::mutex> l{registration_lock, std::try_to_lock};
+      if (!l.owns_lock()) {
+         return;
+      }
+
+      auto now = epochs.try_advance();
+      for (std::uint32_t next = retired.exchange(0U, std::memory_order_acquire); next != 0U; ) {
+         limbo.push_back(next - 1U);
+         next = slots.find(next - 1U)->next_retired;
+      }
+
+      auto waiting = std::partition(begin(limbo), end(limbo), [this, now](std::uint32_t slot) {
+            return !details_::epoch_domain::reclaimable(slots.find(slot)->retired_at, now);
+         });
+      free_slots.insert(end(free_slots), waiting, end(limbo));
+      limbo.erase(waiting, end(limbo));
+   }
+
+   // EPOLL_CTL_MOD fails with EINVAL on an exclusive entry, whichever way it is being changed, so entries that
+   // are or are to become exclusive are replaced instead.  Which it is comes from the interest the kernel was last
+   // given, not from the error, so that no other EINVAL ends up replacing an entry.
+   inline int modify(int fd, mode previous, ::epoll_event &ev) noexcept {
+      if (details_::is_exclusive(previous) || ((ev.events & EPOLLEXCLUSIVE) != 0U)) {
+         return replace(fd, ev);
+      }
+      return ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+   }
+
+   // A registration that cannot be added back once it has been deleted is gone from the kernel, so it is
+   // unpublished as well, unless something else has already taken it down.
+   inline int replace(int fd, ::epoll_event &ev) noexcept {
+      int result = ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+      if (result != 0) {
+         return result;
+      }
+      result = ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+      if (result != 0) {
+         int error = errno;
+         auto *current = tags.find(static_cast<std::size_t>(fd));
+         details_::registration_tag tag = ev.data.u64;
+         if ((current != nullptr) && current->compare_exchange_strong(tag, 0U)) {
+            retire(tag);
+         }
+         errno = error;
+      }
+      return result;
+   }
 
    static inline std::error_code add_to_signals(::sigset_t &signals, const signal_handle &signum) {
       std::error_code result;
@@ -177,7 +688,22 @@ private:
       }
    }
 
-   event_activation_store activations;
+   details_::chunked_table<registration> slots;
+   details_::chunked_table<std::atomic<details_::registration_tag>> tags;
+   details_::epoch_domain epochs;
+   std::atomic<std::thread::id> poller{};
+   std::atomic<std::uint32_t> retired{0U};
+   std::mutex registration_lock;
+   std::atomic<std::uint32_t> next_slot{0U};
+   std::vector<std::uint32_t> free_slots;
+   std::vector<std::uint32_t> limbo;
+   event_buffer_type events;
+   pending_buffer_type pending;
+   std::size_t prefetch_distance{8U};
+   bool grouped_dispatch{false};
+   int numa_node{any_numa_node};
+   trace_recorder *recorder{nullptr};
+   bool placed{false};
    ::sigset_t blocked_signals;
    handle<eventfd_tag, int, -1> epoll_fd;
 };
@@ -3,11 +3,16 @@
 #define EPOLLING_EVENT_ENGINE_H__
 
 #include "activation.h"
+#include "numa.h"
 #include "signal_handle.h"
+#include "bits/futex.h"
 #include <atomic>
 #include <chrono>
 #include <experimental/executor>
 #include <memory>
+#include <system_error>
+#include <thread>
+#include <utility>
 
 namespace epolling {
 
@@ -30,6 +35,8 @@ public:
 
    virtual ~event_engine() noexcept final override;
 
+   // One thread at a time runs or polls an engine, though it may do so again from a handler.  While it does,
+   // run() on another thread fails with device_or_resource_busy, and poll() and poll_one() throw it.
    template<class DurationType=duration_type>
    inline std::error_code run(DurationType timeout=DurationType{-1});
 
@@ -44,14 +51,35 @@ public:
    template<class T, void (T::*OnActivation)(mode), class Tag, class Impl, Impl Invalid, class U>
    inline void start_monitoring(const handle<Tag, Impl, Invalid> &h, mode flags, U &object);
 
+   // Registers a callable held by the activation itself; the service must use an activation that can hold one.
+   template<class Tag, class Impl, Impl Invalid, class F>
+   inline void start_monitoring(const handle<Tag, Impl, Invalid> &h, mode flags, F &&callable);
+
+   // Registers a range of (handle, object pointer) pairs with a single wake-up of the polling thread.
+   template<class T, void (T::*OnActivation)(mode), class InputIterator>
+   inline void start_monitoring(InputIterator first, InputIterator last, mode flags);
+
    template<class Tag, class Impl, Impl Invalid>
    inline void update_monitoring(const handle<Tag, Impl, Invalid> &h, mode flags);
 
+   // Has the service report the handle again if it is still ready, as a change of interest would; for services
+   // that skip an update to the interest a handle already has.  The service must support it.
+   template<class Tag, class Impl, Impl Invalid>
+   inline void rescan(const handle<Tag, Impl, Invalid> &h);
+
    template<class Tag, class Impl, Impl Invalid>
    inline void stop_monitoring(handle<Tag, Impl, Invalid> &h);
 
    inline std::error_code block_signal(signal_handle signum);
 
+   // The service's view of what is registered; safe to call from any thread without stopping the loop.
+   template<class Service=EventService>
+   inline auto snapshot() const -> decltype(std::declval<const Service&>().snapshot());
+
+   // Binds the calling thread, which is to run the engine, to node and moves the service's memory there.  Only
+   // while the engine is not running; fails with device_or_resource_busy otherwise.
+   inline std::error_code bind_to_numa_node(int node);
+
    inline void quit();
    inline bool running() const;
    inline bool polling() const;
@@ -72,10 +100,11 @@ private:
    std::atomic<EventService*> service;
    std::unique_ptr<notification, Delete<notification>> wakeup;
    const std::size_t max_events_per_poll;
-   std::atomic<bool> service_polling;
+   details_::futex_word service_polling;
+   std::atomic<std::thread::id> polling_thread;
    std::atomic<bool> exit_flag;
    std::atomic<bool> quitting;
-   std::atomic<std::ptrdiff_t> execution_count;
+   details_::futex_word execution_count;
    time_point cached_now;
 };
 
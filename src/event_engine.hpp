@@ -35,16 +35,16 @@ template<class EventService>
 class reset_for_execution final {
    using time_point = std::chrono::steady_clock::time_point;
 
-   std::atomic<std::ptrdiff_t> &execution_count;
+   futex_word &execution_count;
 
 public:
-   inline reset_for_execution(std::atomic<bool> &exit_flag, std::atomic<std::ptrdiff_t> &ec, std::error_code &stop_reason,
+   inline reset_for_execution(std::atomic<bool> &exit_flag, futex_word &ec, std::error_code &stop_reason,
                               std::atomic<EventService*> &srvc, time_point &now) noexcept :
       execution_count(ec),
       service(srvc.load())
    {
       if (service != nullptr) {
-         if (++execution_count == 1) {
+         if (execution_count.fetch_add(1) == 0) {
             exit_flag = false;
             stop_reason.clear();
          }
@@ -54,7 +54,7 @@ public:
 
    inline ~reset_for_execution() noexcept {
       if (service != nullptr) {
-         --execution_count;
+         (void)execution_count.fetch_sub(1);
       }
    }
 
@@ -62,24 +62,59 @@ public:
 };
 
 
+// Admits one polling thread at a time: services keep their event buffers and reclamation state per service, not
+// per call.  The thread admitted may poll again from inside a handler.
+class poller_claim final {
+   std::atomic<std::thread::id> &owner;
+   bool claimed;
+   bool admitted;
+
+public:
+   explicit inline poller_claim(std::atomic<std::thread::id> &o) noexcept :
+      owner(o),
+      claimed(false),
+      admitted(false)
+   {
+      std::thread::id expected{};
+      claimed = owner.compare_exchange_strong(expected, std::this_thread::get_id(), std::memory_order_acq_rel);
+      admitted = claimed || (expected == std::this_thread::get_id());
+   }
+
+   poller_claim(const poller_claim &) = delete;
+   poller_claim & operator =(const poller_claim &) = delete;
+
+   inline ~poller_claim() noexcept {
+      if (claimed) {
+         owner.store(std::thread::id{}, std::memory_order_release);
+      }
+   }
+
+   explicit inline operator bool() const noexcept {
+      return admitted;
+   }
+};
+
+
 template<class EventService, class DurationType>
 class poll_service final {
-   std::atomic<bool> &service_polling;
+   futex_word &service_polling;
    std::size_t max_events_to_poll;
    DurationType time_remaining;
    EventService *service;
 public:
-   poll_service(std::atomic<bool> &sp, std::size_t mepp, DurationType tr, EventService *s) :
+   poll_service(futex_word &sp, std::size_t mepp, DurationType tr, EventService *s) :
       service_polling(sp),
       max_events_to_poll(mepp),
       time_remaining(tr),
       service(s)
    {
-      service_polling.store(true, std::memory_order::memory_order_release);
+      (void)service_polling.fetch_add(1);
    }
 
+   // Odd while polling; counting rather than flipping lets a waiter tell that the poll it saw has ended even if
+   // the next one has already begun.
    inline ~poll_service() {
-      service_polling.store(false, std::memory_order::memory_order_release);
+      (void)service_polling.fetch_add(1);
    }
 
    auto go() {
@@ -97,7 +132,8 @@ inline event_engine<ES, D>::event_engine(std::size_t mepp) :
    service(&std::experimental::use_service<ES>(*this)),
    wakeup(),
    max_events_per_poll(mepp),
-   service_polling(false),
+   service_polling(0),
+   polling_thread(),
    exit_flag(false),
    execution_count(0),
    cached_now(std::chrono::steady_clock::now())
@@ -125,6 +161,10 @@ inline event_engine<ES, D>::~event_engine() noexcept {
 template<class ES, template<class> class D>
 template<class DurationType>
 std::error_code event_engine<ES, D>::run(DurationType timeout) {
+   details_::poller_claim claim{polling_thread};
+   if (!claim) {
+      return make_error_code(std::errc::device_or_resource_busy);
+   }
    details_::reset_for_execution<ES> context{exit_flag, execution_count, stop_reason, service, cached_now};
    do_run(context.service, timeout);
    return stop_reason;
@@ -134,6 +174,10 @@ std::error_code event_engine<ES, D>::run(DurationType timeout) {
 template<class ES, template<class> class D>
 template<class DurationType>
 inline bool event_engine<ES, D>::poll(DurationType timeout) {
+   details_::poller_claim claim{polling_thread};
+   if (!claim) {
+      throw std::system_error(make_error_code(std::errc::device_or_resource_busy), "Another thread is polling the engine.");
+   }
    details_::reset_for_execution<ES> context{exit_flag, execution_count, stop_reason, service, cached_now};
    return do_poll(context.service, max_events_per_poll, timeout);
 }
@@ -142,6 +186,10 @@ inline bool event_engine<ES, D>::poll(DurationType timeout) {
 template<class ES, template<class> class D>
 template<class DurationType>
 inline bool event_engine<ES, D>::poll_one(DurationType timeout) {
+   details_::poller_claim claim{polling_thread};
+   if (!claim) {
+      throw std::system_error(make_error_code(std::errc::device_or_resource_busy), "Another thread is polling the engine.");
+   }
    details_::reset_for_execution<ES> context{exit_flag, execution_count, stop_reason, service, cached_now};
    return do_poll(context.service, 1U, timeout);
 }
@@ -161,7 +209,35 @@ inline void event_engine<ES, D>::start_monitoring(const handle<Tag, Impl, Invali
    ES *srvc = service.load();
    if ((srvc != nullptr) && h.valid()) {
       wait_until_woken_up();
-      srvc->start_monitoring<T, OnActivation>(h, flags, object);
+      srvc->template start_monitoring<T, OnActivation>(h, flags, object);
+   }
+}
+
+
+template<class ES, template<class> class D>
+template<class Tag, class Impl, Impl Invalid, class F>
+inline void event_engine<ES, D>::start_monitoring(const handle<Tag, Impl, Invalid> &h, mode flags, F &&callable) {
+   using std::forward;
+
+   ES *srvc = service.load();
+   if ((srvc != nullptr) && h.valid()) {
+      wait_until_woken_up();
+      srvc->start_monitoring(h, flags, forward<F>(callable));
+   }
+}
+
+
+template<class ES, template<class> class D>
+template<class T, void (T::*OnActivation)(mode), class InputIterator>
+inline void event_engine<ES, D>::start_monitoring(InputIterator first, InputIterator last, mode flags) {
+   ES *srvc = service.load();
+   if ((srvc != nullptr) && (first != last)) {
+      wait_until_woken_up();
+      for (; first != last; ++first) {
+         if (first->first.valid()) {
+            srvc->template start_monitoring<T, OnActivation>(first->first, flags, *first->second);
+         }
+      }
    }
 }
 
@@ -179,10 +255,22 @@ inline void event_engine<ES, D>::update_monitoring(const handle<Tag, Impl, Inval
 
 template<class ES, template<class> class D>
 template<class Tag, class Impl, Impl Invalid>
-inline void event_engine<ES, D>::stop_monitoring(handle<Tag, Impl, Invalid> &h) {
+inline void event_engine<ES, D>::rescan(const handle<Tag, Impl, Invalid> &h) {
    ES *srvc = service.load();
    if ((srvc != nullptr) && h.valid()) {
       wait_until_woken_up();
+      srvc->rescan(h);
+   }
+}
+
+
+template<class ES, template<class> class D>
+template<class Tag, class Impl, Impl Invalid>
+inline void event_engine<ES, D>::stop_monitoring(handle<Tag, Impl, Invalid> &h) {
+   // The service copes with events for a handle that is going away, and waits itself for a handler that may still
+   // be running, so there is no need to wake the poller.
+   ES *srvc = service.load();
+   if ((srvc != nullptr) && h.valid()) {
       srvc->stop_monitoring(h);
       h = {};
    }
@@ -191,8 +279,6 @@ inline void event_engine<ES, D>::stop_monitoring(handle<Tag, Impl, Invalid> &h)
 
 template<class ES, template<class> class D>
 inline std::error_code event_engine<ES, D>::block_signal(signal_handle signum) {
-   using std::this_thread::yield;
-
    std::error_code result{};
    ES *srvc = service.load();
    if ((srvc != nullptr) && signum.valid()) {
@@ -203,6 +289,29 @@ inline std::error_code event_engine<ES, D>::block_signal(signal_handle signum) {
 }
 
 
+template<class ES, template<class> class D>
+template<class Service>
+inline auto event_engine<ES, D>::snapshot() const -> decltype(std::declval<const Service&>().snapshot()) {
+   Service *srvc = service.load();
+   return (srvc != nullptr) ? srvc->snapshot() : decltype(srvc->snapshot()){};
+}
+
+
+template<class ES, template<class> class D>
+inline std::error_code event_engine<ES, D>::bind_to_numa_node(int node) {
+   // Moving the service's memory swaps out the buffers a poller would be using, even from one of its handlers.
+   if (running()) {
+      return make_error_code(std::errc::device_or_resource_busy);
+   }
+   std::error_code result = epolling::bind_to_numa_node(node);
+   ES *srvc = service.load();
+   if (!result && (srvc != nullptr)) {
+      srvc->set_numa_node(node);
+   }
+   return result;
+}
+
+
 template<class ES, template<class> class D>
 inline void event_engine<ES, D>::quit() {
    stop(std::error_code{});
@@ -211,13 +320,13 @@ inline void event_engine<ES, D>::quit() {
 
 template<class ES, template<class> class D>
 inline bool event_engine<ES, D>::running() const {
-   return execution_count > 0;
+   return execution_count.load() > 0;
 }
 
 
 template<class ES, template<class> class D>
 inline bool event_engine<ES, D>::polling() const {
-   return service_polling.load(std::memory_order_consume);
+   return (service_polling.load(std::memory_order_acquire) & 1) != 0;
 }
 
 
@@ -235,9 +344,9 @@ inline void event_engine<ES, D>::do_stop(ES *srvc, std::error_code reason) {
       bool expected = false;
       if (exit_flag.compare_exchange_weak(expected, true, std::memory_order_acq_rel, std::memory_order_relaxed) && !expected) {
          stop_reason = move(reason);
-         if (polling()) {
-            wakeup->set(1);
-         }
+         // Woken whether polling or not: a poller that has seen exit_flag clear but not yet blocked would
+         // otherwise wait for ever.  A wakeup nobody was waiting for ends one later poll early.
+         wakeup->set(1);
       }
    }
 }
@@ -245,23 +354,17 @@ inline void event_engine<ES, D>::do_stop(ES *srvc, std::error_code reason) {
 
 template<class ES, template<class> class D>
 inline void event_engine<ES, D>::wait_until_not_running() {
-   using std::this_thread::yield;
-
-   while (running()) {
-      yield();
-   }
+   execution_count.wait_while([](std::int32_t count) { return count > 0; });
 }
 
 
 template<class ES, template<class> class D>
 inline void event_engine<ES, D>::wait_until_woken_up() {
-   using std::this_thread::yield;
-
-   if (polling()) {
+   // The polling thread itself gets here from inside a handler; waiting for itself to stop polling would never end.
+   std::int32_t seen = service_polling.load(std::memory_order_acquire);
+   if (((seen & 1) != 0) && (polling_thread.load(std::memory_order_relaxed) != std::this_thread::get_id())) {
       wakeup->set(1);
-      while (polling()) {
-         yield();
-      }
+      service_polling.wait_while([seen](std::int32_t now) { return now == seen; });
    }
 }
 
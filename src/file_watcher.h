@@ -0,0 +1,250 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_FILE_WATCHER_H__
+#define EPOLLING_FILE_WATCHER_H__
+
+#include "activation.h"
+#include "mode.h"
+#include "unique_handle.h"
+#include "bits/exceptions.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/inotify.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace epolling {
+
+// Watches files and directories through one inotify descriptor registered with the engine.  Each readiness edge
+// drains the descriptor in large reads, and the events found are folded per watch: every watch that saw anything
+// is called once, after the descriptor has been drained, with the union of what it saw.  A burst of writes to a
+// file being replaced therefore costs one reload rather than dozens.  The names of directory entries are not
+// passed on, as they cannot be folded; a handler that needs them looks for itself.
+//
+// A watch that the kernel drops, because what it watched is gone or was unmounted, sees IN_IGNORED and is
+// forgotten.  When the kernel's queue overflows every watch sees IN_Q_OVERFLOW, since any of them may have missed
+// something.
+//
+// The kernel hands out watch descriptors cyclically, so they keep growing as paths are watched, dropped and watched
+// again.  They are therefore looked up in a small sorted index, and the watches themselves are kept in slots that
+// are recycled through a free list; the table only grows with the number of watches held at once.
+//
+// All member functions, and the handlers, run on the engine's polling thread.  Handlers may add and remove watches.
+template<class EventEngine>
+class file_watcher final {
+   struct inotify_tag {};
+
+public:
+   typedef int watch_type;
+   typedef basic_activation<void(std::uint32_t)> handler_type;
+
+   template<class T, void (T::*OnChange)(std::uint32_t), class U>
+   static inline handler_type create_handler(U &object) noexcept {
+      return handler_type::template create<T, OnChange>(object);
+   }
+
+   // Throws std::system_error.
+   explicit file_watcher(EventEngine &e);
+   file_watcher() = delete;
+   file_watcher(const file_watcher &) = delete;
+   file_watcher & operator =(const file_watcher &) = delete;
+
+   inline ~file_watcher() noexcept {
+      handle<inotify_tag, int, -1> h{inotify.get_handle()};
+      engine.stop_monitoring(h);
+   }
+
+   // mask is made of IN_* flags, as for inotify_add_watch().  Watching the same path again replaces its handler
+   // and mask and returns the same watch.
+   watch_type watch(const std::string &path, std::uint32_t mask, handler_type h, std::error_code &ec);
+
+   std::error_code unwatch(watch_type w) noexcept;
+
+   inline bool watching(watch_type w) const noexcept {
+      return lookup(w) != end(index);
+   }
+
+   inline std::size_t size() const noexcept {
+      return index.size();
+   }
+
+private:
+   struct entry {
+      handler_type handler;
+      std::uint32_t pending;
+      watch_type wd;
+   };
+
+   typedef std::pair<watch_type, std::size_t> index_entry;
+
+   static constexpr std::size_t buffer_size = 64U * 1024U;
+
+   static native_handle_type create_inotify();
+
+   static inline bool precedes(const index_entry &e, watch_type w) noexcept {
+      return e.first < w;
+   }
+
+   inline typename std::vector<index_entry>::const_iterator lookup(watch_type w) const noexcept {
+      auto i = std::lower_bound(begin(index), end(index), w, &file_watcher::precedes);
+      return ((i != end(index)) && (i->first == w)) ? i : end(index);
+   }
+
+   inline void note(std::size_t slot, std::uint32_t mask) {
+      entry &e = watches[slot];
+      if (e.pending == 0U) {
+         changed.push_back(slot);
+      }
+      e.pending |= mask;
+   }
+
+   // The slot goes back to the free list; a stale slot number left in changed finds nothing pending, or a watch
+   // added since, which it leaves alone.
+   inline void release(typename std::vector<index_entry>::const_iterator i) noexcept {
+      entry &e = watches[i->second];
+      e.handler = handler_type{};
+      e.pending = 0U;
+      e.wd = -1;
+      free_slots.push_back(i->second);
+      index.erase(i);
+   }
+
+   void on_activation(mode activation_flags);
+   void deliver();
+
+   EventEngine &engine;
+   std::vector<entry> watches;
+   std::vector<std::size_t> free_slots;
+   std::vector<index_entry> index;
+   std::vector<std::size_t> changed;
+   std::vector<std::size_t> delivering;
+   std::vector<char> buffer;
+   unique_handle<handle<inotify_tag, int, -1>, int (*)(int)> inotify;
+};
+
+
+template<class EventEngine>
+inline file_watcher<EventEngine>::file_watcher(EventEngine &e) :
+   engine(e),
+   watches(),
+   free_slots(),
+   index(),
+   changed(),
+   delivering(),
+   buffer(buffer_size),
+   inotify({}, &::close)
+{
+   inotify.reset(create_inotify());
+   engine.template start_monitoring<file_watcher, &file_watcher::on_activation>(inotify.get_handle(), mode::read, *this);
+}
+
+
+template<class EventEngine>
+inline typename file_watcher<EventEngine>::watch_type file_watcher<EventEngine>::watch(const std::string &path, std::uint32_t mask,
+                                                                                      handler_type h, std::error_code &ec) {
+   watch_type w = safe([this, &path, mask] { return ::inotify_add_watch(inotify.get_handle(), path.c_str(), mask); }, ec);
+   if (ec) {
+      return -1;
+   }
+
+   auto i = std::lower_bound(begin(index), end(index), w, &file_watcher::precedes);
+   if ((i == end(index)) || (i->first != w)) {
+      if (free_slots.empty()) {
+         watches.push_back(entry{handler_type{}, 0U, -1});
+         free_slots.push_back(watches.size() - 1U);
+      }
+      i = index.insert(i, index_entry{w, free_slots.back()});
+      free_slots.pop_back();
+   }
+   entry &e = watches[i->second];
+   e.wd = w;
+   e.handler = h;
+   return w;
+}
+
+
+template<class EventEngine>
+inline std::error_code file_watcher<EventEngine>::unwatch(watch_type w) noexcept {
+   auto i = lookup(w);
+   if (i == end(index)) {
+      return make_error_code(std::errc::invalid_argument);
+   }
+   release(i);
+
+   std::error_code ec;
+   (void)safe([this, w] { return ::inotify_rm_watch(inotify.get_handle(), w); }, ec);
+   return ec;
+}
+
+
+template<class EventEngine>
+inline void file_watcher<EventEngine>::on_activation(mode activation_flags) {
+   (void)activation_flags;
+
+   for (;;) {
+      ssize_t size = ::read(inotify.get_handle(), buffer.data(), buffer.size());
+      if (size <= 0) {
+         if ((size < 0) && (errno == EINTR)) {
+            continue;
+         }
+         break;
+      }
+
+      for (const char *p = buffer.data(); p < buffer.data() + size; ) {
+         ::inotify_event event;
+         std::memcpy(&event, p, sizeof(event));
+         p += sizeof(event) + event.len;
+
+         if ((event.mask & IN_Q_OVERFLOW) != 0U) {
+            for (const index_entry &i : index) {
+               note(i.second, IN_Q_OVERFLOW);
+            }
+         }
+         else {
+            auto i = lookup(event.wd);
+            if (i != end(index)) {
+               note(i->second, event.mask);
+            }
+         }
+      }
+   }
+
+   deliver();
+}
+
+
+template<class EventEngine>
+inline void file_watcher<EventEngine>::deliver() {
+   using std::swap;
+
+   swap(changed, delivering);
+   for (std::size_t slot : delivering) {
+      entry &e = watches[slot];
+      std::uint32_t mask = e.pending;
+      e.pending = 0U;
+      // Removed, and possibly handed to another watch, by an earlier handler.
+      if (mask == 0U) {
+         continue;
+      }
+      handler_type handler = e.handler;
+      if ((mask & IN_IGNORED) != 0U) {
+         release(lookup(e.wd));
+      }
+      handler.execute(std::uint32_t{mask});
+   }
+   delivering.clear();
+}
+
+
+template<class EventEngine>
+inline native_handle_type file_watcher<EventEngine>::create_inotify() {
+   return safe([] { return ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC); }, "Failed to create inotify instance.");
+}
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "framing.h"
+#if defined(__SSE2__)
+#  include <immintrin.h>
+#endif
+
+using std::experimental::string_view;
+
+namespace epolling {
+
+namespace details_ {
+
+std::size_t find_byte_scalar(const char *data, std::size_t size, char byte) noexcept {
+   std::size_t i = 0U;
+   while ((i < size) && (data[i] != byte)) {
+      ++i;
+   }
+   return i;
+}
+
+
+#if defined(__SSE2__)
+
+std::size_t find_byte_sse2(const char *data, std::size_t size, char byte) noexcept {
+   const __m128i needle = _mm_set1_epi8(byte);
+   std::size_t i = 0U;
+   for (; i + 16U <= size; i += 16U) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      int found = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+      if (found != 0) {
+         return i + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(found)));
+      }
+   }
+   return i + find_byte_scalar(data + i, size - i, byte);
+}
+
+
+__attribute__((target("avx2")))
+std::size_t find_byte_avx2(const char *data, std::size_t size, char byte) noexcept {
+   const __m256i needle = _mm256_set1_epi8(byte);
+   std::size_t i = 0U;
+   for (; i + 32U <= size; i += 32U) {
+      __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+      int found = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+      if (found != 0) {
+         return i + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(found)));
+      }
+   }
+   return i + find_byte_sse2(data + i, size - i, byte);
+}
+
+#endif
+
+
+namespace {
+
+find_byte_type select_find_byte() noexcept {
+#if defined(__SSE2__)
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) {
+      return &find_byte_avx2;
+   }
+   return &find_byte_sse2;
+#else
+   return &find_byte_scalar;
+#endif
+}
+
+}
+
+
+std::size_t find_byte(const char *data, std::size_t size, char byte) noexcept {
+   static const find_byte_type selected = select_find_byte();
+   return selected(data, size, byte);
+}
+
+}
+
+
+std::size_t line_framer::feed(const char *data, std::size_t size, std::error_code &ec) {
+   ec.clear();
+   if (scanned > size) {
+      scanned = 0U;
+   }
+
+   std::size_t consumed = 0U;
+   for (;;) {
+      const char *line = data + consumed;
+      std::size_t available = size - consumed;
+      std::size_t end = scanned + details_::find_byte(line + scanned, available - scanned, '\n');
+      if (end == available) {
+         scanned = available;
+         if (available > max_size) {
+            ec = make_error_code(std::errc::message_size);
+         }
+         return consumed;
+      }
+
+      std::size_t length = ((end > 0U) && (line[end - 1U] == '\r')) ? (end - 1U) : end;
+      if (length > max_size) {
+         ec = make_error_code(std::errc::message_size);
+         return consumed;
+      }
+      scanned = 0U;
+      consumed += end + 1U;
+      listener.execute(string_view{line, length});
+   }
+}
+
+
+std::size_t length_prefixed_framer::feed(const char *data, std::size_t size, std::error_code &ec) {
+   ec.clear();
+
+   std::size_t consumed = 0U;
+   while (size - consumed >= header_size) {
+      const auto *header = reinterpret_cast<const unsigned char*>(data + consumed);
+      std::size_t length = (static_cast<std::size_t>(header[0]) << 24U) | (static_cast<std::size_t>(header[1]) << 16U) |
+                           (static_cast<std::size_t>(header[2]) << 8U) | static_cast<std::size_t>(header[3]);
+      if (length > max_size) {
+         ec = make_error_code(std::errc::message_size);
+         break;
+      }
+      if (size - consumed - header_size < length) {
+         break;
+      }
+      consumed += header_size + length;
+      listener.execute(string_view{data + consumed - length, length});
+   }
+   return consumed;
+}
+
+}
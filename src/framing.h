@@ -0,0 +1,101 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_FRAMING_H__
+#define EPOLLING_FRAMING_H__
+
+#include "activation.h"
+#include <cstddef>
+#include <cstdint>
+#include <experimental/string_view>
+#include <system_error>
+
+namespace epolling {
+
+namespace details_ {
+
+typedef std::size_t (*find_byte_type)(const char *data, std::size_t size, char byte);
+
+// The offset of the first byte in [data, data + size) equal to byte, or size if there is none.
+std::size_t find_byte_scalar(const char *data, std::size_t size, char byte) noexcept;
+#if defined(__SSE2__)
+// SSE2 is part of x86-64, so this one needs no check; AVX2 does.
+std::size_t find_byte_sse2(const char *data, std::size_t size, char byte) noexcept;
+std::size_t find_byte_avx2(const char *data, std::size_t size, char byte) noexcept;
+#endif
+
+// The best of the above that the CPU we run on supports, chosen on first use.
+std::size_t find_byte(const char *data, std::size_t size, char byte) noexcept;
+
+}
+
+
+// Splits a byte stream into lines ending in "\n" or "\r\n" and hands each to the listener, terminator excluded,
+// as a view into the data passed to feed().  A view is only good until feed() returns.
+//
+// feed() consumes whole lines only; the caller keeps the incomplete remainder and presents it again, followed
+// by whatever arrives next.  The framer remembers how much of that remainder it has already scanned; a caller
+// that drops the remainder instead, after a failure or on reconnecting, calls reset() first.  Data shorter than
+// what was scanned cannot be that remainder, so it is scanned from the start.
+class line_framer final {
+public:
+   typedef std::experimental::string_view frame_type;
+   typedef basic_activation<void(frame_type)> listener_type;
+
+   template<class T, void (T::*OnFrame)(frame_type), class U>
+   static inline listener_type create_listener(U &object) noexcept {
+      return listener_type::template create<T, OnFrame>(object);
+   }
+
+   inline line_framer(std::size_t max_frame_size, listener_type l) noexcept :
+      max_size(max_frame_size),
+      listener(l),
+      scanned(0U)
+   {
+   }
+
+   // Returns the number of bytes consumed.  Fails with message_size, consuming nothing more, once the incomplete
+   // remainder grows beyond the maximum frame size.
+   std::size_t feed(const char *data, std::size_t size, std::error_code &ec);
+
+   inline void reset() noexcept {
+      scanned = 0U;
+   }
+
+private:
+   const std::size_t max_size;
+   listener_type listener;
+   std::size_t scanned;
+};
+
+
+// Splits a byte stream into frames that each start with their payload's length as a 32 bit big endian integer,
+// and hands each payload to the listener as a view into the data passed to feed().  Otherwise as line_framer.
+class length_prefixed_framer final {
+public:
+   typedef std::experimental::string_view frame_type;
+   typedef basic_activation<void(frame_type)> listener_type;
+
+   constexpr static std::size_t header_size = sizeof(std::uint32_t);
+
+   template<class T, void (T::*OnFrame)(frame_type), class U>
+   static inline listener_type create_listener(U &object) noexcept {
+      return listener_type::template create<T, OnFrame>(object);
+   }
+
+   inline length_prefixed_framer(std::size_t max_frame_size, listener_type l) noexcept :
+      max_size(max_frame_size),
+      listener(l)
+   {
+   }
+
+   // Returns the number of bytes consumed.  Fails with message_size, consuming nothing more, on a header that
+   // announces a payload larger than the maximum frame size.
+   std::size_t feed(const char *data, std::size_t size, std::error_code &ec);
+
+private:
+   const std::size_t max_size;
+   listener_type listener;
+};
+
+}
+
+#endif
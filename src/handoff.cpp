@@ -0,0 +1,218 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "handoff.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/time.h>
+
+namespace epolling {
+
+namespace {
+
+// The most descriptors the kernel takes in one message (SCM_MAX_FD).
+constexpr std::size_t max_handles_per_batch = 253U;
+
+// Each batch is one datagram: the number of handles and the kind of each, with the handles themselves attached.
+// A batch of none ends the handoff, and is answered with a single byte once everything has been received.
+struct batch_header {
+   std::uint32_t count;
+   std::uint32_t kinds[max_handles_per_batch];
+};
+
+constexpr char confirmation = 'k';
+
+
+struct socket_tag {};
+
+typedef unique_handle<handle<socket_tag, int, -1>, int (*)(int)> socket_type;
+
+
+sockaddr_un address_of(const std::string &path, std::error_code &ec) noexcept {
+   sockaddr_un address{};
+   address.sun_family = AF_UNIX;
+   if (path.size() >= sizeof(address.sun_path)) {
+      ec = make_error_code(std::errc::filename_too_long);
+      return address;
+   }
+   std::memcpy(address.sun_path, path.c_str(), path.size() + 1U);
+   return address;
+}
+
+
+int send_batch(int fd, const handed_off *first, std::size_t count) noexcept {
+   batch_header header{static_cast<std::uint32_t>(count), {}};
+   alignas(::cmsghdr) char control[CMSG_SPACE(max_handles_per_batch * sizeof(int))] = {};
+
+   ::iovec payload{&header, sizeof(header.count) + count * sizeof(header.kinds[0])};
+   ::msghdr message{};
+   message.msg_iov = &payload;
+   message.msg_iovlen = 1U;
+   if (count > 0U) {
+      message.msg_control = control;
+      message.msg_controllen = CMSG_SPACE(count * sizeof(int));
+      ::cmsghdr *attached = CMSG_FIRSTHDR(&message);
+      attached->cmsg_level = SOL_SOCKET;
+      attached->cmsg_type = SCM_RIGHTS;
+      attached->cmsg_len = CMSG_LEN(count * sizeof(int));
+      auto *handles = reinterpret_cast<int *>(CMSG_DATA(attached));
+      for (std::size_t i = 0U; i < count; ++i) {
+         header.kinds[i] = first[i].kind;
+         handles[i] = first[i].handle;
+      }
+   }
+
+   ssize_t result = 0;
+   do {
+      result = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+   } while ((result < 0) && (errno == EINTR));
+   return (result < 0) ? -1 : 0;
+}
+
+}
+
+
+std::error_code hand_off(const std::string &path, const std::vector<handed_off> &handles,
+                         std::chrono::milliseconds timeout) noexcept {
+   using std::chrono::duration_cast;
+   using std::chrono::microseconds;
+   using std::chrono::seconds;
+
+   std::error_code ec;
+   sockaddr_un address = address_of(path, ec);
+   if (ec) {
+      return ec;
+   }
+
+   socket_type peer({}, &::close);
+   (void)safe([&peer, &address, timeout] {
+         int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+         if (fd < 0) {
+            return -1;
+         }
+         peer.reset(handle<socket_tag, int, -1>{fd});
+
+         auto whole_seconds = duration_cast<seconds>(timeout);
+         ::timeval limit{static_cast<time_t>(whole_seconds.count()),
+                         static_cast<suseconds_t>(duration_cast<microseconds>(timeout - whole_seconds).count())};
+         if ((::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit)) != 0) ||
+             (::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit)) != 0)) {
+            return -1;
+         }
+         return ::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+      }, ec);
+   if (ec) {
+      return ec;
+   }
+
+   int fd = peer.get_handle();
+   (void)safe([fd, &handles] {
+         for (std::size_t sent = 0U; sent < handles.size(); sent += max_handles_per_batch) {
+            if (send_batch(fd, handles.data() + sent, std::min(max_handles_per_batch, handles.size() - sent)) < 0) {
+               return -1;
+            }
+         }
+         if (send_batch(fd, nullptr, 0U) < 0) {
+            return -1;
+         }
+
+         char reply = 0;
+         ssize_t result = 0;
+         do {
+            result = ::recv(fd, &reply, sizeof(reply), 0);
+         } while ((result < 0) && (errno == EINTR));
+         if ((result == 0) || ((result > 0) && (reply != confirmation))) {
+            errno = ECONNRESET;
+            return -1;
+         }
+         return (result < 0) ? -1 : 0;
+      }, ec);
+   return ec;
+}
+
+
+namespace details_ {
+
+native_handle_type listen_for_handoff(const std::string &path) {
+   std::error_code ec;
+   sockaddr_un address = address_of(path, ec);
+   if (ec) {
+      throw std::system_error(ec, "Handoff socket path is too long.");
+   }
+
+   int fd = safe([] { return ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0); },
+                 "Failed to create handoff socket.");
+   // What is left at path is the previous receiver's socket, which nothing listens on any more.
+   (void)::unlink(path.c_str());
+   if ((::bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) || (::listen(fd, 1) != 0)) {
+      auto error = make_error_code(static_cast<std::errc>(errno));
+      (void)::close(fd);
+      throw std::system_error(error, "Failed to listen on handoff socket.");
+   }
+   return fd;
+}
+
+
+void receive_handoff(native_handle_type connection, std::vector<handed_off> &handles, bool &done, std::error_code &ec) {
+   done = false;
+   ec.clear();
+   for (;;) {
+      batch_header header{0U, {}};
+      alignas(::cmsghdr) char control[CMSG_SPACE(max_handles_per_batch * sizeof(int))] = {};
+      ::iovec payload{&header, sizeof(header)};
+      ::msghdr message{};
+      message.msg_iov = &payload;
+      message.msg_iovlen = 1U;
+      message.msg_control = control;
+      message.msg_controllen = sizeof(control);
+
+      ssize_t result = ::recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+      if (result < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            ec = make_error_code(static_cast<std::errc>(errno));
+         }
+         return;
+      }
+      if (result == 0) {
+         ec = make_error_code(std::errc::connection_reset);
+         return;
+      }
+
+      std::size_t attached = 0U;
+      for (::cmsghdr *c = CMSG_FIRSTHDR(&message); c != nullptr; c = CMSG_NXTHDR(&message, c)) {
+         if ((c->cmsg_level != SOL_SOCKET) || (c->cmsg_type != SCM_RIGHTS)) {
+            continue;
+         }
+         auto *received = reinterpret_cast<const int *>(CMSG_DATA(c));
+         std::size_t count = (c->cmsg_len - CMSG_LEN(0U)) / sizeof(int);
+         for (std::size_t i = 0U; i < count; ++i, ++attached) {
+            std::uint32_t kind = (attached < header.count) ? header.kinds[attached] : 0U;
+            handles.push_back(handed_off{received[i], kind});
+         }
+      }
+
+      bool malformed = (static_cast<std::size_t>(result) < sizeof(header.count)) || (attached != header.count) ||
+                       ((message.msg_flags & (MSG_CTRUNC | MSG_TRUNC)) != 0);
+      if (malformed) {
+         ec = make_error_code(std::errc::bad_message);
+         return;
+      }
+      if (header.count == 0U) {
+         ssize_t sent = 0;
+         do {
+            sent = ::send(connection, &confirmation, sizeof(confirmation), MSG_NOSIGNAL);
+         } while ((sent < 0) && (errno == EINTR));
+         if (sent < 0) {
+            ec = make_error_code(static_cast<std::errc>(errno));
+         }
+         done = !ec;
+         return;
+      }
+   }
+}
+
+}
+
+}
@@ -0,0 +1,182 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_HANDOFF_H__
+#define EPOLLING_HANDOFF_H__
+
+#include "activation.h"
+#include "handle.h"
+#include "mode.h"
+#include "unique_handle.h"
+#include "bits/exceptions.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace epolling {
+
+// A descriptor passed from one process to another, with what it is to the application (a listening socket, a
+// connection, ...), which the library does not interpret.
+struct handed_off {
+   native_handle_type handle;
+   std::uint32_t kind;
+};
+
+
+// Passes handles to the process whose handoff_receiver listens on path, over a Unix socket with SCM_RIGHTS, and
+// waits up to timeout for it to confirm that it has them all.  The handles stay open here as well; only once this
+// succeeds should the caller stop monitoring and close its copies, which leaves listen queues and connections
+// untouched in the receiver.  On failure the caller still owns and may go on serving everything.  Blocks.
+std::error_code hand_off(const std::string &path, const std::vector<handed_off> &handles,
+                         std::chrono::milliseconds timeout=std::chrono::seconds{5}) noexcept;
+
+
+namespace details_ {
+
+// Binds a non-blocking SOCK_SEQPACKET listener to path, replacing whatever socket was left there.  Throws
+// std::system_error.
+native_handle_type listen_for_handoff(const std::string &path);
+
+// Receives the batches waiting on a handoff connection into handles until it would block.  done is set once the
+// sender has handed off everything, and confirmed to it.
+void receive_handoff(native_handle_type connection, std::vector<handed_off> &handles, bool &done, std::error_code &ec);
+
+}
+
+
+// The receiving end of a restart: the new process listens on a Unix socket path for the process it replaces to
+// hand off its listening sockets, and possibly live connections, with hand_off().  Received handles are passed to
+// the listener batch by batch as they arrive, to be registered with the engine right away; they are the
+// listener's from then on.  A final empty batch says the handoff is complete, or, with an error, that it broke
+// off; the handles already delivered are valid either way.
+//
+// Draining the old process is out of scope here: the library cannot tell what work the application still has in
+// flight, so there is no helper for it.  Once hand_off() succeeds the application itself stops monitoring and
+// closes its copies of what it handed off, waits for its own outstanding work to finish, and quits its engines.
+// Its clients then see neither refused connections nor a cold listen queue.
+//
+// All member functions, and the listener, run on the engine's polling thread.  One handoff is taken at a time.
+template<class EventEngine>
+class handoff_receiver final {
+   struct socket_tag {};
+
+public:
+   typedef handle<socket_tag, int, -1> handle_type;
+   typedef basic_activation<void(std::vector<handed_off> &, std::error_code)> listener_type;
+
+   template<class T, void (T::*OnHandoff)(std::vector<handed_off> &, std::error_code), class U>
+   static inline listener_type create_listener(U &object) noexcept {
+      return listener_type::template create<T, OnHandoff>(object);
+   }
+
+   // Throws std::system_error.
+   handoff_receiver(EventEngine &e, const std::string &path, listener_type l);
+   handoff_receiver() = delete;
+   handoff_receiver(const handoff_receiver &) = delete;
+   handoff_receiver & operator =(const handoff_receiver &) = delete;
+
+   ~handoff_receiver() noexcept;
+
+private:
+   void on_connection(mode activation_flags);
+   void on_handoff(mode activation_flags);
+   void finish(std::error_code error);
+
+   EventEngine &engine;
+   listener_type listener;
+   std::string socket_path;
+   std::vector<handed_off> batch;
+   unique_handle<handle_type, int (*)(int)> listening;
+   unique_handle<handle_type, int (*)(int)> connection;
+};
+
+
+template<class EventEngine>
+inline handoff_receiver<EventEngine>::handoff_receiver(EventEngine &e, const std::string &path, listener_type l) :
+   engine(e),
+   listener(l),
+   socket_path(path),
+   batch(),
+   listening({}, &::close),
+   connection({}, &::close)
+{
+   listening.reset(handle_type{details_::listen_for_handoff(path)});
+   engine.template start_monitoring<handoff_receiver, &handoff_receiver::on_connection>(listening.get_handle(), mode::read, *this);
+}
+
+
+template<class EventEngine>
+inline handoff_receiver<EventEngine>::~handoff_receiver() noexcept {
+   handle_type h{connection.get_handle()};
+   if (h.valid()) {
+      engine.stop_monitoring(h);
+   }
+   h = listening.get_handle();
+   engine.stop_monitoring(h);
+   (void)::unlink(socket_path.c_str());
+}
+
+
+template<class EventEngine>
+inline void handoff_receiver<EventEngine>::on_connection(mode activation_flags) {
+   (void)activation_flags;
+
+   for (;;) {
+      int fd = ::accept4(listening.get_handle(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return;
+      }
+      if (connection.get_handle().valid()) {
+         // Busy with another handoff; the sender sees its connection closed without confirmation.
+         (void)::close(fd);
+         continue;
+      }
+      connection.reset(handle_type{fd});
+      engine.template start_monitoring<handoff_receiver, &handoff_receiver::on_handoff>(connection.get_handle(), mode::read, *this);
+   }
+}
+
+
+template<class EventEngine>
+inline void handoff_receiver<EventEngine>::on_handoff(mode activation_flags) {
+   using std::move;
+
+   bool done = false;
+   std::error_code error;
+   batch.clear();
+   details_::receive_handoff(connection.get_handle(), batch, done, error);
+   if (!batch.empty()) {
+      listener.execute(batch, std::error_code{});
+      batch.clear();
+   }
+
+   if (!done && !error && ((activation_flags & (mode::hangup | mode::error)) != mode::none)) {
+      error = make_error_code(std::errc::connection_reset);
+   }
+   if (done || error) {
+      finish(move(error));
+   }
+}
+
+
+template<class EventEngine>
+inline void handoff_receiver<EventEngine>::finish(std::error_code error) {
+   using std::move;
+
+   handle_type h{connection.get_handle()};
+   engine.stop_monitoring(h);
+   connection.reset();
+   batch.clear();
+   listener.execute(batch, move(error));
+}
+
+}
+
+#endif
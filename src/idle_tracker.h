@@ -0,0 +1,232 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_IDLE_TRACKER_H__
+#define EPOLLING_IDLE_TRACKER_H__
+
+#include "activation.h"
+#include "mode.h"
+#include "unique_handle.h"
+#include "bits/exceptions.h"
+#include <chrono>
+#include <cstdint>
+#include <system_error>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <vector>
+
+namespace epolling {
+
+// Reaps handles that have not been touched for a timeout.  touch() only stores the engine's cached time in a
+// flat table indexed by handle; nothing is rescheduled.  Deadlines are kept in a wheel of coarse buckets which a
+// timer registered with the engine sweeps once per granularity: a handle found in its bucket is either expired
+// or, having been touched since, moved to the bucket of its new deadline.  Expiry is therefore late by up to
+// about two granularities, and each handle is looked at no more than once per timeout however often it is
+// touched.
+//
+// All member functions, and the listener, run on the engine's polling thread.
+template<class EventEngine>
+class idle_tracker final {
+   struct timer_tag {};
+
+public:
+   typedef std::chrono::steady_clock::time_point time_point;
+   typedef std::chrono::nanoseconds duration_type;
+   typedef basic_activation<void(native_handle_type)> listener_type;
+
+   template<class T, void (T::*OnIdle)(native_handle_type), class U>
+   static inline listener_type create_listener(U &object) noexcept {
+      return listener_type::template create<T, OnIdle>(object);
+   }
+
+   // Throws std::system_error, with invalid_argument unless 0 < granularity <= timeout.
+   idle_tracker(EventEngine &e, duration_type timeout, duration_type granularity, listener_type l);
+   idle_tracker() = delete;
+   idle_tracker(const idle_tracker &) = delete;
+   idle_tracker & operator =(const idle_tracker &) = delete;
+
+   inline ~idle_tracker() noexcept {
+      handle<timer_tag, int, -1> h{timer.get_handle()};
+      engine.stop_monitoring(h);
+   }
+
+   void track(native_handle_type h);
+
+   // A handle that is not tracked is ignored, as it is by forget().
+   inline void touch(native_handle_type h) noexcept {
+      if (tracking(h)) {
+         entries[static_cast<std::size_t>(h)].last_active = engine.time();
+      }
+   }
+
+   inline void forget(native_handle_type h) noexcept {
+      if (tracking(h)) {
+         entries[static_cast<std::size_t>(h)].tracked = false;
+         --num_tracked;
+      }
+   }
+
+   inline bool tracking(native_handle_type h) const noexcept {
+      return (h >= 0) && (static_cast<std::size_t>(h) < entries.size()) && entries[static_cast<std::size_t>(h)].tracked;
+   }
+
+   inline std::size_t size() const noexcept {
+      return num_tracked;
+   }
+
+   void expire(time_point now);
+
+private:
+   struct entry {
+      time_point last_active;
+      std::int64_t tick;
+      bool tracked;
+   };
+
+   static duration_type checked_granularity(duration_type timeout, duration_type granularity);
+   static native_handle_type create_timer(duration_type granularity);
+
+   inline std::int64_t deadline_tick(time_point last_active) const noexcept {
+      auto deadline = (last_active + timeout).time_since_epoch();
+      return (deadline.count() + granularity.count() - 1) / granularity.count();
+   }
+
+   inline std::int64_t tick_of(time_point now) const noexcept {
+      return now.time_since_epoch().count() / granularity.count();
+   }
+
+   inline void schedule(native_handle_type h, entry &e) {
+      e.tick = deadline_tick(e.last_active);
+      wheel[static_cast<std::size_t>(e.tick) % wheel.size()].push_back(h);
+   }
+
+   void on_activation(mode activation_flags);
+
+   EventEngine &engine;
+   const duration_type timeout;
+   const duration_type granularity;
+   listener_type listener;
+   std::vector<entry> entries;
+   std::vector<std::vector<native_handle_type>> wheel;
+   std::vector<native_handle_type> sweeping;
+   std::int64_t swept_tick;
+   std::size_t num_tracked;
+   unique_handle<handle<timer_tag, int, -1>, int (*)(int)> timer;
+};
+
+
+template<class EventEngine>
+inline idle_tracker<EventEngine>::idle_tracker(EventEngine &e, duration_type t, duration_type g, listener_type l) :
+   engine(e),
+   timeout(t),
+   granularity(checked_granularity(t, g)),
+   listener(l),
+   entries(),
+   wheel(static_cast<std::size_t>(t / granularity) + 2),
+   sweeping(),
+   swept_tick(tick_of(e.time())),
+   num_tracked(0),
+   timer({}, &::close)
+{
+   timer.reset(create_timer(g));
+   engine.template start_monitoring<idle_tracker, &idle_tracker::on_activation>(timer.get_handle(), mode::read, *this);
+}
+
+
+template<class EventEngine>
+inline void idle_tracker<EventEngine>::track(native_handle_type h) {
+   auto index = static_cast<std::size_t>(h);
+   if (entries.size() <= index) {
+      entries.resize(index + 1, entry{time_point{}, 0, false});
+   }
+
+   entry &e = entries[index];
+   if (!e.tracked) {
+      e.tracked = true;
+      ++num_tracked;
+   }
+   e.last_active = engine.time();
+   schedule(h, e);
+}
+
+
+template<class EventEngine>
+inline void idle_tracker<EventEngine>::expire(time_point now) {
+   using std::max;
+   using std::swap;
+
+   std::int64_t now_tick = tick_of(now);
+   std::int64_t first_tick = max(swept_tick + 1, now_tick - static_cast<std::int64_t>(wheel.size()) + 1);
+
+   for (std::int64_t tick = first_tick; tick <= now_tick; ++tick) {
+      auto &bucket = wheel[static_cast<std::size_t>(tick) % wheel.size()];
+      swap(bucket, sweeping);
+      for (native_handle_type h : sweeping) {
+         entry &e = entries[static_cast<std::size_t>(h)];
+         // Forgetting or tracking a handle again leaves a stale copy behind in its old bucket.
+         if (!e.tracked || (&wheel[static_cast<std::size_t>(e.tick) % wheel.size()] != &bucket)) {
+            continue;
+         }
+
+         if (e.tick > now_tick) {
+            // Due on a later turn of the wheel; only reachable when a sweep has fallen behind.
+            bucket.push_back(h);
+         }
+         else if (e.last_active + timeout <= now) {
+            e.tracked = false;
+            --num_tracked;
+            listener.execute(native_handle_type{h});
+         }
+         else {
+            schedule(h, e);
+         }
+      }
+      sweeping.clear();
+   }
+
+   swept_tick = max(swept_tick, now_tick);
+}
+
+
+// Checked before the wheel is sized by it: a zero granularity would divide by zero, and disarm the timer besides.
+template<class EventEngine>
+inline typename idle_tracker<EventEngine>::duration_type
+idle_tracker<EventEngine>::checked_granularity(duration_type timeout, duration_type granularity) {
+   if ((granularity <= duration_type::zero()) || (granularity > timeout)) {
+      throw std::system_error(make_error_code(std::errc::invalid_argument), "Invalid idle tracker granularity.");
+   }
+   return granularity;
+}
+
+
+template<class EventEngine>
+inline native_handle_type idle_tracker<EventEngine>::create_timer(duration_type granularity) {
+   using std::chrono::duration_cast;
+   using std::chrono::seconds;
+
+   native_handle_type result = safe([] { return ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC); },
+                                    "Failed to create idle tracker timer.");
+
+   auto whole_seconds = duration_cast<seconds>(granularity);
+   ::timespec period{static_cast<time_t>(whole_seconds.count()), static_cast<long>((granularity - whole_seconds).count())};
+   ::itimerspec spec{period, period};
+   if (::timerfd_settime(result, 0, &spec, nullptr) < 0) {
+      std::error_code error{errno, std::system_category()};
+      (void)::close(result);
+      throw std::system_error(error, "Failed to arm idle tracker timer.");
+   }
+   return result;
+}
+
+
+template<class EventEngine>
+inline void idle_tracker<EventEngine>::on_activation(mode activation_flags) {
+   (void)activation_flags;
+
+   std::uint64_t expirations = 0;
+   if (::read(timer.get_handle(), &expirations, sizeof(expirations)) > 0) {
+      expire(engine.time());
+   }
+}
+
+}
+
+#endif
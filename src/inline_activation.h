@@ -0,0 +1,100 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_INLINE_ACTIVATION_H__
+#define EPOLLING_INLINE_ACTIVATION_H__
+
+#include "activation.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace epolling {
+
+template<class Signature, std::size_t Capacity=3 * sizeof(void *)> struct basic_inline_activation;
+
+namespace details_ {
+
+template<class Signature, class F> struct inline_trampoline;
+
+template<class R, class ... Args, class F>
+struct inline_trampoline<R(Args...), F> final {
+   static inline R jump(void *storage, Args ... args) {
+      assert(storage != nullptr);
+      return (*static_cast<F*>(storage))(args...);
+   }
+};
+
+
+template<class Signature, class U, class MemberFunction, MemberFunction OnActivation> struct bound_member;
+
+template<class R, class ... Args, class U, class MemberFunction, MemberFunction OnActivation>
+struct bound_member<R(Args...), U, MemberFunction, OnActivation> final {
+   inline R operator()(Args ... args) const {
+      assert(object != nullptr);
+      return (object->*OnActivation)(args...);
+   }
+
+   U *object;
+};
+
+}
+
+
+// An activation that carries its callable with it rather than pointing at one, so that a lambda can be registered
+// without a std::function, and so without allocating, while dispatch remains a single indirect call.  Callables
+// are copied bitwise along with the activation and never destroyed, so they must be trivially copyable and
+// trivially destructible, and fit in Capacity bytes at no more than pointer alignment; anything else is rejected
+// at compile time.
+template<class R, class ... Args, std::size_t Capacity>
+struct basic_inline_activation<R(Args...), Capacity> final {
+   typedef R (*callback_type)(void *, Args...);
+   typedef R result_type;
+   template<class T> using member_type = R (T::*)(Args...);
+
+   constexpr static std::size_t capacity = Capacity;
+
+   callback_type callback;
+   alignas(void *) unsigned char storage[Capacity];
+
+   template<class T, member_type<T> OnActivation, class U>
+   static inline basic_inline_activation create(U &object) noexcept {
+      return create(details_::bound_member<R(Args...), U, member_type<T>, OnActivation>{&object});
+   }
+
+   template<class F>
+   static inline basic_inline_activation create(F &&callable) noexcept {
+      using std::forward;
+      using callable_type = std::decay_t<F>;
+      static_assert(sizeof(callable_type) <= Capacity, "Callable does not fit in the activation's inline storage.");
+      static_assert(alignof(callable_type) <= alignof(void *), "Callable is aligned more strictly than a pointer.");
+      static_assert(std::is_trivially_copyable<callable_type>::value, "Callable must be trivially copyable.");
+      static_assert(std::is_trivially_destructible<callable_type>::value, "Callable must be trivially destructible.");
+
+      basic_inline_activation result{&details_::inline_trampoline<R(Args...), callable_type>::jump, {}};
+      ::new (static_cast<void *>(result.storage)) callable_type(forward<F>(callable));
+      return result;
+   }
+
+   inline R execute(Args && ... args) {
+      using std::forward;
+
+      assert(callback != nullptr);
+      return (*callback)(storage, forward<Args>(args)...);
+   }
+
+   inline std::uintptr_t dispatch_key() const noexcept {
+      return reinterpret_cast<std::uintptr_t>(callback);
+   }
+
+   // Nothing to fetch ahead: the callable lives in the activation itself, which is fetched along with its
+   // registration, and whatever the callable refers to is out of sight.
+   inline const void *target() const noexcept {
+      return nullptr;
+   }
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "mirrored_buffer.h"
+#include "unique_handle.h"
+#include "bits/exceptions.h"
+#include <cerrno>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace epolling {
+
+namespace {
+
+struct memfd_tag {};
+
+typedef unique_handle<handle<memfd_tag, int, -1>, int (*)(int)> memfd_type;
+
+
+std::size_t round_to_pages(std::size_t size) {
+   auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+   return ((size + page - 1U) / page) * page;
+}
+
+}
+
+
+namespace details_ {
+
+char *map_twice(native_handle_type memory, std::size_t offset, std::size_t length) {
+   // Reserve both halves first so that nothing else can be mapped between them.
+   void *reserved = ::mmap(nullptr, 2U * length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (reserved == MAP_FAILED) {
+      throw std::system_error(make_error_code(static_cast<std::errc>(errno)), "Failed to reserve mirrored buffer.");
+   }
+
+   auto *first = static_cast<char*>(reserved);
+   for (char *half : {first, first + length}) {
+      if (::mmap(half, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memory, static_cast<off_t>(offset)) == MAP_FAILED) {
+         auto error = make_error_code(static_cast<std::errc>(errno));
+         (void)::munmap(reserved, 2U * length);
+         throw std::system_error(error, "Failed to map mirrored buffer.");
+      }
+   }
+   return first;
+}
+
+}
+
+
+mirrored_buffer::mirrored_buffer(std::size_t c) :
+   length(round_to_pages((c > 0U) ? c : 1U)),
+   base(nullptr),
+   head(0U),
+   tail(0U)
+{
+   memfd_type memory{{}, &::close};
+   memory.reset(safe([] { return ::memfd_create("epolling-mirrored-buffer", MFD_CLOEXEC); },
+                     "Failed to create mirrored buffer memory."));
+   auto fd = memory.get_handle();
+   (void)safe([fd, this] { return ::ftruncate(fd, static_cast<off_t>(length)); },
+              "Failed to size mirrored buffer memory.");
+   // The mappings keep the memory alive once the descriptor is closed.
+   base = details_::map_twice(fd, 0U, length);
+}
+
+
+mirrored_buffer::~mirrored_buffer() noexcept {
+   (void)::munmap(base, 2U * length);
+}
+
+
+std::size_t mirrored_buffer::receive(native_handle_type stream, std::error_code &ec) noexcept {
+   ec.clear();
+   if (space() == 0U) {
+      // Reading into nothing would look just like the end of the stream.
+      ec = make_error_code(std::errc::no_buffer_space);
+      return 0U;
+   }
+   for (;;) {
+      ssize_t n = ::read(stream, free_space(), space());
+      if (n >= 0) {
+         commit(static_cast<std::size_t>(n));
+         return static_cast<std::size_t>(n);
+      }
+      if (errno != EINTR) {
+         ec = make_error_code(static_cast<std::errc>(errno));
+         return 0U;
+      }
+   }
+}
+
+}
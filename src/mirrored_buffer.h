@@ -0,0 +1,94 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_MIRRORED_BUFFER_H__
+#define EPOLLING_MIRRORED_BUFFER_H__
+
+#include "handle.h"
+#include <cstddef>
+#include <system_error>
+
+namespace epolling {
+
+namespace details_ {
+
+// Maps length bytes of memory from offset twice, back to back, shared.  length and offset must be multiples of
+// the page size.  Throws std::system_error.
+char *map_twice(native_handle_type memory, std::size_t offset, std::size_t length);
+
+}
+
+
+// A ring buffer whose memory is mapped twice, back to back, so that the readable data and the free space are
+// each one contiguous range however they wrap.  Receiving is a single read() into the free space, and a frame
+// that straddles the end of the ring reaches the framer in one piece without being copied.
+//
+// Capacity is rounded up to a multiple of the page size.  Not thread safe.
+class mirrored_buffer final {
+public:
+   // Throws std::system_error.
+   explicit mirrored_buffer(std::size_t capacity);
+   mirrored_buffer() = delete;
+   mirrored_buffer(const mirrored_buffer &) = delete;
+   mirrored_buffer & operator =(const mirrored_buffer &) = delete;
+
+   ~mirrored_buffer() noexcept;
+
+   inline const char *data() const noexcept {
+      return base + head;
+   }
+
+   inline std::size_t size() const noexcept {
+      return tail - head;
+   }
+
+   inline bool empty() const noexcept {
+      return tail == head;
+   }
+
+   inline char *free_space() noexcept {
+      return base + tail;
+   }
+
+   inline std::size_t space() const noexcept {
+      return length - size();
+   }
+
+   inline std::size_t capacity() const noexcept {
+      return length;
+   }
+
+   // Makes n bytes written to free_space() readable.
+   inline void commit(std::size_t n) noexcept {
+      tail += n;
+   }
+
+   inline void consume(std::size_t n) noexcept {
+      head += n;
+      if (head >= length) {
+         head -= length;
+         tail -= length;
+      }
+   }
+
+   // Reads whatever fits from a non-blocking stream.  Returns how much was read, 0 with no error at end of
+   // stream, 0 with resource_unavailable_try_again once the stream is drained, and 0 with no_buffer_space when
+   // the buffer is full.
+   std::size_t receive(native_handle_type stream, std::error_code &ec) noexcept;
+
+   // Hands the readable data to a framer (see framing.h) and consumes the frames it took.
+   template<class Framer>
+   inline std::size_t deliver(Framer &framer, std::error_code &ec) {
+      std::size_t consumed = framer.feed(data(), size(), ec);
+      consume(consumed);
+      return consumed;
+   }
+
+private:
+   std::size_t length;
+   char *base;
+   std::size_t head;
+   std::size_t tail;
+};
+
+}
+
+#endif
@@ -10,6 +10,12 @@ enum class mode : int {
    write = 0x02,
    urgent_read = 0x05,
    one_time = 0x08,
+   hangup = 0x10,
+   error = 0x20,
+   exclusive = 0x40,
+   // With one_time, has the service re-arm the registration once its handler returns, unless the handler
+   // re-armed or changed it itself.
+   rearm = 0x80,
    read_write = read | write,
    urgent_read_write = urgent_read | write
 };
@@ -12,6 +12,14 @@ using std::system_error;
 namespace epolling {
 
 void notification::set(uint64_t value) {
+   if (how_to_behave == behavior::conditional) {
+      // Test before exchanging so that concurrent setters only read the cache line while a wakeup is pending.
+      if (wakeup_pending.load(std::memory_order_relaxed) ||
+          wakeup_pending.exchange(true, std::memory_order_acq_rel)) {
+         return;
+      }
+   }
+
 #if 0
    auto error = std::get<std::error_code>(handle.write(&value, sizeof(value)));
    if (error) {
@@ -35,7 +43,14 @@ native_handle_type notification::create_native_handle(behavior b, uint64_t initi
 
 void notification::on_activation(mode activation_flags) {
    (void) activation_flags;
-   ::read(event_fd.get_handle(), &last_read_value, sizeof(last_read_value));
+   // Read before clearing.  A set() that lands in between still sees the wakeup pending and is dropped, which is
+   // fine as the listener runs afterwards and sees whatever it published.  Clearing first would let such a set()
+   // write a value the read then consumes, leaving the flag set with nothing left to wake us.
+   bool was_read = ::read(event_fd.get_handle(), &last_read_value, sizeof(last_read_value)) > 0;
+   wakeup_pending.store(false, std::memory_order_release);
+   if (was_read && (listener.callback != nullptr)) {
+      listener.execute(uint64_t{last_read_value});
+   }
 }
 
 }
@@ -3,7 +3,9 @@
 #define EPOLLING_NOTIFICATION_H__
 
 #include "mode.h"
+#include "static_activation.h"
 #include "unique_handle.h"
+#include <atomic>
 #include <cstdint>
 #include <unistd.h>
 
@@ -23,25 +25,47 @@ public:
       semaphore
    };
 
+   // Invoked on the polling thread with the value read from the event file descriptor.
+   typedef basic_activation<void(uint64_t)> listener_type;
+
+   template<class T, void (T::*OnNotified)(uint64_t), class U>
+   static inline listener_type create_listener(U &object) noexcept {
+      return listener_type::template create<T, OnNotified>(object);
+   }
+
    template<class ES, template<class> class D>
-   notification(event_engine<ES, D> &e, behavior how_to_behave, uint64_t initial_value);
+   notification(event_engine<ES, D> &e, behavior how_to_behave, uint64_t initial_value, listener_type l={nullptr, nullptr});
    notification() = delete;
-   notification(notification &&) = default;
-   notification& operator =(notification &&) = default;
+   // The engine holds on to this object's address for the lifetime of the registration.
+   notification(notification &&) = delete;
+   notification& operator =(notification &&) = delete;
    notification(const notification &) = delete;
    notification& operator =(const notification &) = delete;
 
+   // A conditional notification coalesces: while a wakeup is pending, further calls do not touch the event file
+   // descriptor and their values are dropped.  A semaphore notification writes every value.
    void set(uint64_t value);
    inline uint64_t get() const {
       return last_read_value;
    }
 
+   inline bool pending() const {
+      return wakeup_pending.load(std::memory_order_acquire);
+   }
+
 private:
    static native_handle_type create_native_handle(epolling::notification::behavior behavior, uint64_t initial_value);
    void on_activation(mode activation_flags);
 
+   const behavior how_to_behave;
+   std::atomic<bool> wakeup_pending;
    uint64_t last_read_value;
+   listener_type listener;
    unique_handle<handle_type, native_handle_type (*)(native_handle_type)> event_fd;
+
+public:
+   // Names the activation handler for compile-time handler sets (see basic_static_activation).
+   typedef activation_handler<notification, void (notification::*)(mode), &notification::on_activation> handler_type;
 };
 
 }
@@ -52,8 +76,11 @@ private:
 namespace epolling {
 
 template<class ES, template<class> class D>
-inline notification::notification(event_engine<ES, D> &engine, behavior how_to_behave, uint64_t initial_value) :
+inline notification::notification(event_engine<ES, D> &engine, behavior b, uint64_t initial_value, listener_type l) :
+   how_to_behave(b),
+   wakeup_pending(initial_value != 0),
    last_read_value(std::numeric_limits<uint64_t>::max()),
+   listener(l),
    event_fd({}, &::close)
 {
    event_fd.reset(create_native_handle(how_to_behave, initial_value));
@@ -0,0 +1,136 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "numa.h"
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace epolling {
+
+namespace {
+
+constexpr int max_nodes = 1024;
+
+typedef unsigned long node_mask[max_nodes / (CHAR_BIT * sizeof(unsigned long))];
+
+
+inline std::error_code last_error() noexcept {
+   return std::error_code{errno, std::system_category()};
+}
+
+
+inline bool valid_node(int node) noexcept {
+   return (node >= 0) && (node < max_nodes);
+}
+
+
+inline void set_node(node_mask &mask, int node) noexcept {
+   constexpr int bits = CHAR_BIT * sizeof(unsigned long);
+   mask[node / bits] |= 1UL << (node % bits);
+}
+
+
+// Ranges as the kernel prints them, e.g. "0-3,8-11"; calls f for each number.  False if the file is missing.
+template<class F>
+bool for_each_in_list(const char *path, F f) {
+   std::FILE *file = std::fopen(path, "re");
+   if (file == nullptr) {
+      return false;
+   }
+
+   int first = 0;
+   int last = 0;
+   int matched = 0;
+   while ((matched = std::fscanf(file, "%d-%d", &first, &last)) > 0) {
+      for (int i = first; i <= ((matched == 2) ? last : first); ++i) {
+         f(i);
+      }
+      if (std::fgetc(file) != ',') {
+         break;
+      }
+   }
+   (void)std::fclose(file);
+   return true;
+}
+
+
+inline long bind_memory(void *pointer, std::size_t size, int node, unsigned flags) noexcept {
+   node_mask mask{};
+   set_node(mask, node);
+   return ::syscall(SYS_mbind, pointer, size, MPOL_PREFERRED, mask, static_cast<unsigned long>(max_nodes), flags);
+}
+
+}
+
+
+int current_numa_node() noexcept {
+   unsigned cpu = 0U;
+   unsigned node = 0U;
+   return (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) ? static_cast<int>(node) : any_numa_node;
+}
+
+
+int numa_node_count() noexcept {
+   int result = 0;
+   (void)for_each_in_list("/sys/devices/system/node/online", [&result](int node) { result = node + 1; });
+   return (result > 0) ? result : 1;
+}
+
+
+std::error_code bind_to_numa_node(int node) noexcept {
+   if (!valid_node(node)) {
+      return make_error_code(std::errc::invalid_argument);
+   }
+
+   char path[64];
+   (void)std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+   ::cpu_set_t cpus;
+   CPU_ZERO(&cpus);
+   if (!for_each_in_list(path, [&cpus](int cpu) { CPU_SET(cpu, &cpus); })) {
+      return make_error_code(std::errc::no_such_device);
+   }
+   if (::sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+      return last_error();
+   }
+
+   node_mask mask{};
+   set_node(mask, node);
+   if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, static_cast<unsigned long>(max_nodes)) < 0) {
+      return last_error();
+   }
+   return {};
+}
+
+
+void *allocate_on_numa_node(std::size_t size, int node) {
+   void *result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (result == MAP_FAILED) {
+      throw std::bad_alloc{};
+   }
+   // Placement is a preference; a kernel without NUMA support refuses mbind and the memory is just as usable.
+   if (valid_node(node)) {
+      (void)bind_memory(result, size, node, 0U);
+   }
+   return result;
+}
+
+
+void deallocate_on_numa_node(void *pointer, std::size_t size) noexcept {
+   if (pointer != nullptr) {
+      (void)::munmap(pointer, size);
+   }
+}
+
+
+std::error_code move_to_numa_node(void *pointer, std::size_t size, int node) noexcept {
+   if (!valid_node(node)) {
+      return make_error_code(std::errc::invalid_argument);
+   }
+   return (bind_memory(pointer, size, node, MPOL_MF_MOVE) < 0) ? last_error() : std::error_code{};
+}
+
+}
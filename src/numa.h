@@ -0,0 +1,83 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_NUMA_H__
+#define EPOLLING_NUMA_H__
+
+#include <cstddef>
+#include <new>
+#include <system_error>
+#include <type_traits>
+
+namespace epolling {
+
+// Stands for "wherever the kernel sees fit" when a node is expected.
+constexpr int any_numa_node = -1;
+
+// The node of the CPU the calling thread is running on, or any_numa_node if the kernel will not say.
+int current_numa_node() noexcept;
+
+// The number of nodes the kernel has online; 1 on machines without NUMA.
+int numa_node_count() noexcept;
+
+// Keeps the calling thread on the CPUs of node and has its future allocations prefer node's memory.
+std::error_code bind_to_numa_node(int node) noexcept;
+
+// Page-granular allocation whose pages prefer node, falling back on others when node runs short.  Meant for large,
+// long-lived structures.  Throws std::bad_alloc.
+void *allocate_on_numa_node(std::size_t size, int node);
+void deallocate_on_numa_node(void *pointer, std::size_t size) noexcept;
+
+// Migrates the pages of an earlier allocate_on_numa_node() to node and has them prefer it from then on.
+std::error_code move_to_numa_node(void *pointer, std::size_t size, int node) noexcept;
+
+
+template<class T>
+class numa_allocator {
+public:
+   typedef T value_type;
+   // Containers take the node along with the memory.
+   typedef std::true_type propagate_on_container_copy_assignment;
+   typedef std::true_type propagate_on_container_move_assignment;
+   typedef std::true_type propagate_on_container_swap;
+
+   template<class U> friend class numa_allocator;
+
+   constexpr explicit numa_allocator(int n=any_numa_node) noexcept :
+      target(n)
+   {
+   }
+
+   template<class U>
+   constexpr numa_allocator(const numa_allocator<U> &other) noexcept :
+      target(other.target)
+   {
+   }
+
+   inline T *allocate(std::size_t n) {
+      return static_cast<T*>(allocate_on_numa_node(n * sizeof(T), target));
+   }
+
+   inline void deallocate(T *pointer, std::size_t n) noexcept {
+      deallocate_on_numa_node(pointer, n * sizeof(T));
+   }
+
+   constexpr inline int node() const noexcept {
+      return target;
+   }
+
+   template<class U>
+   constexpr inline bool operator ==(const numa_allocator<U> &other) const noexcept {
+      return target == other.target;
+   }
+
+   template<class U>
+   constexpr inline bool operator !=(const numa_allocator<U> &other) const noexcept {
+      return target != other.target;
+   }
+
+private:
+   int target;
+};
+
+}
+
+#endif
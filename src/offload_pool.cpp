@@ -0,0 +1,109 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "offload_pool.h"
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+namespace epolling {
+
+offload_pool::~offload_pool() noexcept {
+   {
+      lock_guard<mutex> l{tasks_mutex};
+      stopping = true;
+   }
+   tasks_available.notify_all();
+   for (auto &worker : workers) {
+      worker.join();
+   }
+}
+
+
+std::size_t offload_pool::outstanding() const {
+   lock_guard<mutex> l{tasks_mutex};
+   return num_outstanding;
+}
+
+
+void offload_pool::start(std::size_t num_threads) {
+   completed.reserve(max_outstanding);
+   completing.reserve(max_outstanding);
+   workers.reserve(num_threads);
+   for (std::size_t i = 0; i < num_threads; ++i) {
+      workers.emplace_back([this] { run_worker(); });
+   }
+}
+
+
+std::error_code offload_pool::enqueue(task_type task) {
+   using std::make_error_code;
+   using std::move;
+
+   {
+      lock_guard<mutex> l{tasks_mutex};
+      if (num_outstanding >= max_outstanding) {
+         return make_error_code(std::errc::resource_unavailable_try_again);
+      }
+      ++num_outstanding;
+      tasks.emplace_back(move(task));
+   }
+   tasks_available.notify_one();
+   return {};
+}
+
+
+void offload_pool::complete(task_type completion) {
+   using std::move;
+
+   bool was_empty = false;
+   {
+      lock_guard<mutex> l{completed_mutex};
+      was_empty = completed.empty();
+      completed.emplace_back(move(completion));
+   }
+   if (was_empty) {
+      completions_ready.set(1);
+   }
+}
+
+
+void offload_pool::run_worker() {
+   using std::move;
+
+   for (;;) {
+      task_type task;
+      {
+         unique_lock<mutex> l{tasks_mutex};
+         tasks_available.wait(l, [this] { return stopping || !tasks.empty(); });
+         if (stopping) {
+            return;
+         }
+         task = move(tasks.front());
+         tasks.pop_front();
+      }
+      task();
+   }
+}
+
+
+void offload_pool::on_completions(uint64_t value) {
+   using std::swap;
+
+   (void)value;
+   {
+      lock_guard<mutex> l{completed_mutex};
+      swap(completed, completing);
+   }
+
+   for (auto &completion : completing) {
+      completion();
+   }
+
+   {
+      lock_guard<mutex> l{tasks_mutex};
+      num_outstanding -= completing.size();
+   }
+   completing.clear();
+}
+
+}
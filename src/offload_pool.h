@@ -0,0 +1,112 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_OFFLOAD_POOL_H__
+#define EPOLLING_OFFLOAD_POOL_H__
+
+#include "notification.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace epolling {
+
+namespace details_ {
+
+template<class F, class C>
+inline std::function<void()> run_offloaded(F &blocking_call, C &completion, std::true_type) {
+   blocking_call();
+   return [completion] () mutable { completion(); };
+}
+
+
+template<class F, class C>
+inline std::function<void()> run_offloaded(F &blocking_call, C &completion, std::false_type) {
+   auto result = blocking_call();
+   return [completion, result] () mutable { completion(result); };
+}
+
+}
+
+
+// A bounded pool of threads for the calls epoll cannot help with (open, fsync, stat, regular file reads, ...).
+// The blocking call runs on a pool thread; its completion is queued and runs on the engine's polling thread.
+// Completions are delivered in batches: whichever worker finds the completion queue empty signals the engine's
+// notification, and every completion queued by the time it fires runs in the same iteration.
+//
+// Both the blocking call and the completion must be copyable, and neither may throw.  Destroying the pool joins
+// the workers; work that has not started and completions that have not been delivered are dropped.
+class offload_pool final {
+public:
+   template<class ES, template<class> class D>
+   offload_pool(event_engine<ES, D> &engine, std::size_t num_threads, std::size_t max_outstanding);
+   offload_pool() = delete;
+   offload_pool(const offload_pool &) = delete;
+   offload_pool & operator =(const offload_pool &) = delete;
+
+   ~offload_pool() noexcept;
+
+   // Fails with resource_unavailable_try_again once max_outstanding calls are queued, running or awaiting their
+   // completion.
+   template<class F, class C>
+   inline std::error_code submit(F blocking_call, C completion) {
+      return enqueue([blocking_call, completion, this] () mutable {
+            complete(details_::run_offloaded(blocking_call, completion, std::is_void<std::result_of_t<F()>>{}));
+         });
+   }
+
+   std::size_t outstanding() const;
+
+private:
+   typedef std::function<void()> task_type;
+
+   void start(std::size_t num_threads);
+   std::error_code enqueue(task_type task);
+   void complete(task_type completion);
+   void run_worker();
+   void on_completions(uint64_t value);
+
+   const std::size_t max_outstanding;
+   mutable std::mutex tasks_mutex;
+   std::condition_variable tasks_available;
+   std::deque<task_type> tasks;
+   std::size_t num_outstanding;
+   bool stopping;
+   std::mutex completed_mutex;
+   std::vector<task_type> completed;
+   std::vector<task_type> completing;
+   std::vector<std::thread> workers;
+   notification completions_ready;
+};
+
+}
+
+
+#include "event_engine.h"
+
+namespace epolling {
+
+template<class ES, template<class> class D>
+inline offload_pool::offload_pool(event_engine<ES, D> &engine, std::size_t num_threads, std::size_t mo) :
+   max_outstanding(mo),
+   tasks_mutex(),
+   tasks_available(),
+   tasks(),
+   num_outstanding(0),
+   stopping(false),
+   completed_mutex(),
+   completed(),
+   completing(),
+   workers(),
+   completions_ready(engine, notification::behavior::conditional, 0,
+                     notification::create_listener<offload_pool, &offload_pool::on_completions>(*this))
+{
+   start(num_threads);
+}
+
+}
+
+#endif
@@ -0,0 +1,117 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "readiness_trace.h"
+#include "bits/exceptions.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace epolling {
+
+namespace {
+
+constexpr char magic[8] = {'E', 'P', 'T', 'R', 'A', 'C', 'E', '1'};
+
+
+template<class T>
+bool take(const std::vector<char> &data, std::size_t &offset, T &value) {
+   if (data.size() - offset < sizeof(T)) {
+      return false;
+   }
+   std::memcpy(&value, data.data() + offset, sizeof(T));
+   offset += sizeof(T);
+   return true;
+}
+
+}
+
+
+std::error_code readiness_trace::load(const char *path) {
+   using std::make_error_code;
+
+   int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      return make_error_code(static_cast<std::errc>(errno));
+   }
+
+   std::vector<char> data;
+   char chunk[65536];
+   ssize_t n = 0;
+   while (((n = ::read(fd, chunk, sizeof(chunk))) > 0) || ((n < 0) && (errno == EINTR))) {
+      data.insert(data.end(), chunk, chunk + std::max<ssize_t>(n, 0));
+   }
+   std::error_code error = (n < 0) ? make_error_code(static_cast<std::errc>(errno)) : std::error_code{};
+   (void)::close(fd);
+   if (error) {
+      return error;
+   }
+
+   if ((data.size() < sizeof(magic)) || (std::memcmp(data.data(), magic, sizeof(magic)) != 0)) {
+      return make_error_code(std::errc::invalid_argument);
+   }
+
+   std::vector<trace_batch> batches;
+   std::vector<trace_event> events;
+   std::size_t offset = sizeof(magic);
+   std::int64_t at = 0;
+   std::uint32_t count = 0U;
+   while (take(data, offset, at)) {
+      if (!take(data, offset, count)) {
+         return make_error_code(std::errc::invalid_argument);
+      }
+      batches.push_back({std::chrono::nanoseconds{at}, events.size(), count});
+      for (std::uint32_t i = 0U; i < count; ++i) {
+         trace_event e{0, 0U};
+         if (!take(data, offset, e)) {
+            return make_error_code(std::errc::invalid_argument);
+         }
+         events.push_back(e);
+      }
+   }
+
+   recorded_batches.swap(batches);
+   recorded_events.swap(events);
+   return {};
+}
+
+
+trace_recorder::trace_recorder(const char *path) :
+   file({}, &::close),
+   buffer(),
+   origin(),
+   started(false),
+   write_error()
+{
+   file.reset(safe([path] { return ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644); },
+                   "Failed to create readiness trace."));
+   buffer.reserve(buffer_size + 4096U);
+   append(magic, sizeof(magic));
+}
+
+
+trace_recorder::~trace_recorder() noexcept {
+   (void)flush();
+}
+
+
+std::error_code trace_recorder::flush() noexcept {
+   std::size_t written = 0U;
+   while (written < buffer.size()) {
+      ssize_t n = ::write(file.get_handle(), buffer.data() + written, buffer.size() - written);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         if (!write_error) {
+            write_error = make_error_code(static_cast<std::errc>(errno));
+         }
+         break;
+      }
+      written += static_cast<std::size_t>(n);
+   }
+   buffer.clear();
+   return write_error;
+}
+
+}
@@ -0,0 +1,118 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_READINESS_TRACE_H__
+#define EPOLLING_READINESS_TRACE_H__
+
+#include "handle.h"
+#include "mode.h"
+#include "unique_handle.h"
+#include <chrono>
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+namespace epolling {
+
+// A stream of readiness as an EventService returned it, batch by batch.  On disk, after an 8 byte magic, each
+// batch is its time since the recording started (int64 nanoseconds) and its size (uint32), followed by that
+// many (int32 handle, uint32 mode) pairs, all in host byte order.
+struct trace_event {
+   std::int32_t handle;
+   std::uint32_t flags;
+};
+
+
+struct trace_batch {
+   std::chrono::nanoseconds at;
+   std::size_t first;
+   std::size_t count;
+};
+
+
+class readiness_trace final {
+public:
+   readiness_trace() :
+      recorded_batches(),
+      recorded_events()
+   {
+   }
+
+   std::error_code load(const char *path);
+
+   inline const std::vector<trace_batch> &batches() const noexcept {
+      return recorded_batches;
+   }
+
+   inline const trace_event &event(std::size_t i) const noexcept {
+      return recorded_events[i];
+   }
+
+   inline std::size_t size() const noexcept {
+      return recorded_events.size();
+   }
+
+private:
+   std::vector<trace_batch> recorded_batches;
+   std::vector<trace_event> recorded_events;
+};
+
+
+// Appends batches to a trace file.  Writes are buffered and only reach the file a buffer at a time, on flush()
+// and on destruction, so recording costs the polling thread a few stores per event.
+class trace_recorder final {
+   struct tag {};
+
+public:
+   typedef std::chrono::steady_clock::time_point time_point;
+
+   constexpr static std::size_t buffer_size = 1U << 16U;
+
+   // Throws std::system_error.
+   explicit trace_recorder(const char *path);
+   trace_recorder() = delete;
+   trace_recorder(const trace_recorder &) = delete;
+   trace_recorder & operator =(const trace_recorder &) = delete;
+
+   ~trace_recorder() noexcept;
+
+   inline void begin_batch(time_point now, std::size_t count) {
+      if (!started) {
+         started = true;
+         origin = now;
+      }
+      std::int64_t at = std::chrono::duration_cast<std::chrono::nanoseconds>(now - origin).count();
+      auto size = static_cast<std::uint32_t>(count);
+      append(&at, sizeof(at));
+      append(&size, sizeof(size));
+   }
+
+   inline void add(native_handle_type h, mode flags) {
+      trace_event e{static_cast<std::int32_t>(h), static_cast<std::uint32_t>(flags)};
+      append(&e, sizeof(e));
+   }
+
+   std::error_code flush() noexcept;
+
+   // The first error met writing the file, if any; recording carries on regardless.
+   inline std::error_code error() const noexcept {
+      return write_error;
+   }
+
+private:
+   inline void append(const void *data, std::size_t size) {
+      auto *first = static_cast<const char*>(data);
+      buffer.insert(buffer.end(), first, first + size);
+      if (buffer.size() >= buffer_size) {
+         (void)flush();
+      }
+   }
+
+   unique_handle<handle<tag, int, -1>, int (*)(int)> file;
+   std::vector<char> buffer;
+   time_point origin;
+   bool started;
+   std::error_code write_error;
+};
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_REPLAY_SERVICE_H__
+#define EPOLLING_REPLAY_SERVICE_H__
+
+#include "activation.h"
+#include "handle.h"
+#include "mode.h"
+#include "readiness_trace.h"
+#include "signal_handle.h"
+#include "bits/chunked_table.h"
+#include "bits/simulated_registration.h"
+#include <algorithm>
+#include <chrono>
+#include <experimental/executor>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace epolling {
+
+// An EventService that plays back a readiness_trace, recorded by epoll_service, to whatever is registered under
+// the recorded handles.  Batches go out either as fast as the engine polls or at the pace they were recorded
+// at, measured from the first poll after set_trace().  Events for handles nobody registered are dropped.
+//
+// Registrations outside the trace, such as the engine's own notification, are accepted and never activated.
+// Once the trace is over, poll() returns at once with nothing done; see finished().  set_trace() must not be
+// called while the engine polls.
+template<class Activation>
+class basic_replay_service : public std::experimental::execution_context::service {
+public:
+   using activation_type = Activation;
+
+   enum class pacing {
+      as_fast_as_possible,
+      original
+   };
+
+   explicit basic_replay_service(std::experimental::execution_context &e) :
+      std::experimental::execution_context::service(e),
+      trace(),
+      pace(pacing::as_fast_as_possible),
+      registrations(),
+      next_batch(0U),
+      next_in_batch(0U),
+      started(),
+      playing(false)
+   {
+   }
+
+   virtual ~basic_replay_service() noexcept final override {
+   }
+
+   inline void set_trace(readiness_trace t, pacing p) {
+      using std::move;
+
+      trace = move(t);
+      pace = p;
+      next_batch = 0U;
+      next_in_batch = 0U;
+      playing = false;
+   }
+
+   inline bool finished() const noexcept {
+      return next_batch >= trace.batches().size();
+   }
+
+   template<class T, void (T::*OnActivation)(mode), class Tag, class Impl, Impl Invalid, class U>
+   inline std::error_code start_monitoring(const handle<Tag, Impl, Invalid> &h, mode flags, U &object) {
+      registration *r = registrations.reserve(static_cast<std::size_t>(h));
+      if (r == nullptr) {
+         return make_error_code(std::errc::too_many_files_open);
+      }
+      r->activation = activation_type::template create<T, OnActivation>(object);
+      r->interest = flags;
+      r->registered.store(true, std::memory_order_release);
+      return {};
+   }
+
+   template<class Tag, class Impl, Impl Invalid>
+   inline std::error_code update_monitoring(const handle<Tag, Impl, Invalid> &h, mode flags) noexcept {
+      registration *r = registrations.find(static_cast<std::size_t>(h));
+      if (r != nullptr) {
+         r->interest = flags;
+      }
+      return {};
+   }
+
+   // May be called from any thread, including from a handler.
+   template<class Tag, class Impl, Impl Invalid>
+   inline std::error_code stop_monitoring(const handle<Tag, Impl, Invalid> &h) noexcept {
+      registration *r = registrations.find(static_cast<std::size_t>(h));
+      if (r != nullptr) {
+         r->registered.store(false, std::memory_order_release);
+      }
+      return {};
+   }
+
+   std::pair<std::error_code, bool> poll(std::size_t max_events, std::chrono::nanoseconds timeout);
+
+   inline std::error_code block_signal(const signal_handle &signum) noexcept {
+      (void)signum;
+      return {};
+   }
+
+private:
+   typedef details_::simulated_registration<activation_type> registration;
+
+   // False if the next batch is not due within timeout.
+   bool wait_for_next_batch(std::chrono::nanoseconds timeout);
+
+   virtual void shutdown_service() final override {
+   }
+
+   readiness_trace trace;
+   pacing pace;
+   details_::chunked_table<registration> registrations;
+   std::size_t next_batch;
+   std::size_t next_in_batch;
+   std::chrono::steady_clock::time_point started;
+   bool playing;
+};
+
+
+using replay_service = basic_replay_service<basic_activation<void(mode)>>;
+
+
+template<class Activation>
+bool basic_replay_service<Activation>::wait_for_next_batch(std::chrono::nanoseconds timeout) {
+   using std::chrono::steady_clock;
+
+   auto now = steady_clock::now();
+   if (!playing) {
+      playing = true;
+      started = now - trace.batches()[next_batch].at;
+   }
+   if ((pace == pacing::as_fast_as_possible) || (next_in_batch > 0U)) {
+      return true;
+   }
+
+   auto due = started + trace.batches()[next_batch].at;
+   if (due > now) {
+      if ((timeout >= std::chrono::nanoseconds::zero()) && (due - now > timeout)) {
+         std::this_thread::sleep_for(timeout);
+         return false;
+      }
+      std::this_thread::sleep_until(due);
+   }
+   return true;
+}
+
+
+template<class Activation>
+std::pair<std::error_code, bool> basic_replay_service<Activation>::poll(std::size_t max_events, std::chrono::nanoseconds timeout) {
+   if (finished() || !wait_for_next_batch(timeout)) {
+      return std::make_pair(std::error_code{}, false);
+   }
+
+   const trace_batch &batch = trace.batches()[next_batch];
+   std::size_t last = std::min(batch.count, next_in_batch + max_events);
+   bool executed = false;
+   for (; next_in_batch < last; ++next_in_batch) {
+      const trace_event &e = trace.event(batch.first + next_in_batch);
+      registration *r = (e.handle >= 0) ? registrations.find(static_cast<std::size_t>(e.handle)) : nullptr;
+      if (r != nullptr) {
+         executed = r->fire(static_cast<mode>(e.flags)) || executed;
+      }
+   }
+   if (next_in_batch == batch.count) {
+      ++next_batch;
+      next_in_batch = 0U;
+   }
+   return std::make_pair(std::error_code{}, executed);
+}
+
+}
+
+#endif
@@ -0,0 +1,115 @@
+// vim: sw=3 ts=3 expandtab cindent
+#include "shm_channel.h"
+#include "mirrored_buffer.h"
+#include "bits/exceptions.h"
+#include <cerrno>
+#include <new>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace epolling {
+
+namespace details_ {
+
+namespace {
+
+std::size_t page_size() noexcept {
+   return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+
+std::size_t control_size() noexcept {
+   std::size_t page = page_size();
+   return ((sizeof(shm_control) + page - 1U) / page) * page;
+}
+
+
+// Powers of two of at least a page are multiples of it, as mappings need, and let indices wrap with a mask.
+std::size_t ring_size(std::size_t capacity) noexcept {
+   std::size_t result = page_size();
+   while (result < capacity) {
+      result <<= 1U;
+   }
+   return result;
+}
+
+}
+
+
+shm_mapping::shm_mapping(native_handle_type memory) :
+   control_length(control_size()),
+   length(0U),
+   control(nullptr),
+   rings{nullptr, nullptr}
+{
+   struct ::stat status{};
+   (void)safe([memory, &status] { return ::fstat(memory, &status); }, "Failed to size shared memory.");
+   void *mapped = ::mmap(nullptr, control_length, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+   if (mapped == MAP_FAILED) {
+      throw std::system_error(make_error_code(static_cast<std::errc>(errno)), "Failed to map shared memory.");
+   }
+   control = static_cast<shm_control *>(mapped);
+
+   // The size comes from the other process; the rings must be what the memory actually holds.
+   length = static_cast<std::size_t>(control->capacity);
+   if ((length != ring_size(length)) ||
+       (static_cast<std::size_t>(status.st_size) != control_length + 2U * length)) {
+      (void)::munmap(control, control_length);
+      throw std::system_error(make_error_code(std::errc::invalid_argument), "Not a shared memory channel.");
+   }
+
+   try {
+      rings[0] = map_twice(memory, control_length, length);
+      rings[1] = map_twice(memory, control_length + length, length);
+   }
+   catch (...) {
+      if (rings[0] != nullptr) {
+         (void)::munmap(rings[0], 2U * length);
+      }
+      (void)::munmap(control, control_length);
+      throw;
+   }
+}
+
+
+shm_mapping::~shm_mapping() noexcept {
+   for (char *r : rings) {
+      (void)::munmap(r, 2U * length);
+   }
+   (void)::munmap(control, control_length);
+}
+
+
+native_handle_type create_shm(std::size_t capacity) {
+   std::size_t length = ring_size(capacity);
+   std::size_t control_length = control_size();
+
+   int fd = safe([] { return ::memfd_create("epolling-shm-channel", MFD_CLOEXEC); }, "Failed to create shared memory.");
+   void *mapped = MAP_FAILED;
+   if (::ftruncate(fd, static_cast<off_t>(control_length + 2U * length)) == 0) {
+      mapped = ::mmap(nullptr, control_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   }
+   if (mapped == MAP_FAILED) {
+      auto error = make_error_code(static_cast<std::errc>(errno));
+      (void)::close(fd);
+      throw std::system_error(error, "Failed to set up shared memory.");
+   }
+
+   auto *control = new (mapped) shm_control();
+   control->capacity = length;
+   for (shm_ring &r : control->rings) {
+      r.consumer_idle.store(true);
+   }
+   (void)::munmap(mapped, control_length);
+   return fd;
+}
+
+
+native_handle_type create_doorbell() {
+   return safe([] { return ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK); }, "Failed to create doorbell.");
+}
+
+}
+
+}
@@ -0,0 +1,363 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_SHM_CHANNEL_H__
+#define EPOLLING_SHM_CHANNEL_H__
+
+#include "activation.h"
+#include "handle.h"
+#include "handoff.h"
+#include "mode.h"
+#include "unique_handle.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+namespace epolling {
+
+// The kinds handles() gives a channel's descriptors, for a receiver that is handed other things along with them.
+constexpr std::uint32_t shm_memory_kind = 0x73686d00U;
+constexpr std::uint32_t shm_doorbell_kinds[2] = {0x73686d01U, 0x73686d02U};
+
+
+namespace details_ {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_BOOL_LOCK_FREE == 2,
+              "Atomics shared between processes must be lock free.");
+
+// One direction of a channel.  Producer state, consumer state and the idle flag each have a cache line of their
+// own, as in spsc_channel.
+struct shm_ring {
+   alignas(64) std::atomic<std::uint64_t> tail;
+   alignas(64) std::atomic<std::uint64_t> head;
+   alignas(64) std::atomic<bool> consumer_idle;
+};
+
+
+// The page of control at the start of a channel's memory, followed by the data of each ring.
+struct shm_control {
+   std::uint64_t capacity;
+   shm_ring rings[2];
+};
+
+
+// Both ends' view of a channel's memory: the control page, and each ring's data mapped twice, back to back, so
+// that every message is contiguous however it wraps.
+class shm_mapping final {
+public:
+   // Maps memory created by create_shm().  The descriptor stays the caller's.  Throws std::system_error.
+   explicit shm_mapping(native_handle_type memory);
+   shm_mapping() = delete;
+   shm_mapping(const shm_mapping &) = delete;
+   shm_mapping & operator =(const shm_mapping &) = delete;
+
+   ~shm_mapping() noexcept;
+
+   inline shm_ring &ring(std::size_t direction) noexcept {
+      return control->rings[direction];
+   }
+
+   inline char *data(std::size_t direction) noexcept {
+      return rings[direction];
+   }
+
+   inline std::size_t capacity() const noexcept {
+      return length;
+   }
+
+private:
+   std::size_t control_length;
+   std::size_t length;
+   shm_control *control;
+   char *rings[2];
+};
+
+
+// Creates the memory for a channel whose rings hold capacity bytes each, rounded up to a power of two of at
+// least a page, with both consumers idle.  Throws std::system_error.
+native_handle_type create_shm(std::size_t capacity);
+
+// Creates an event file descriptor for a doorbell.  Throws std::system_error.
+native_handle_type create_doorbell();
+
+}
+
+
+// A channel between two processes on the same host, through memory they share rather than a socket, so that a
+// message is copied once, into the ring, and read where it lies.  Each direction is a single producer, single
+// consumer ring of messages; a message is a 64-bit header with its size followed by its bytes, padded to 8.
+//
+// One process creates the channel and passes what handles() returns to the other, with hand_off() or any other
+// Unix socket and SCM_RIGHTS, which attaches to it.  Each side registers the event file descriptor that is its
+// doorbell with its engine.  A producer rings its peer's doorbell only when the peer's ring goes from empty to
+// not empty, i.e. when the consumer has found it empty and gone idle, so a steady stream of messages costs no
+// system calls.  A consumer drains its ring in batches, up to a ring's worth per iteration, calling the listener
+// with each message in place, and hands the space back to the producer once per batch.  The message is only
+// valid until the listener returns.
+//
+// What is in the ring comes from the other process, and is checked before it is read: a ring whose tail or
+// message sizes do not add up has the listener called once with bad_message and no message, after which nothing
+// more is read from it.
+//
+// Neither side learns that the other has gone away; that is for the application's own protocol, or for the
+// socket the handles were passed over.  All member functions but try_send(), and the listener, run on the
+// engine's polling thread; try_send() must only ever be called from one thread at a time.
+template<class EventEngine>
+class shm_channel final {
+   struct memory_tag {};
+   struct doorbell_tag {};
+
+public:
+   typedef handle<memory_tag, int, -1> memory_handle;
+   typedef handle<doorbell_tag, int, -1> doorbell_handle;
+   typedef basic_activation<void(const char *, std::size_t, std::error_code)> listener_type;
+
+   template<class T, void (T::*OnMessage)(const char *, std::size_t, std::error_code), class U>
+   static inline listener_type create_listener(U &object) noexcept {
+      return listener_type::template create<T, OnMessage>(object);
+   }
+
+   // Creates a channel whose rings hold capacity bytes each.  Throws std::system_error.
+   shm_channel(EventEngine &e, std::size_t capacity, listener_type l);
+
+   // Attaches to the channel another process created, from the handles it passed over.  The channel's handles
+   // among them are this channel's from then on, even if it throws.  Throws std::system_error.
+   shm_channel(EventEngine &e, const std::vector<handed_off> &handles, listener_type l);
+
+   shm_channel() = delete;
+   shm_channel(const shm_channel &) = delete;
+   shm_channel & operator =(const shm_channel &) = delete;
+
+   ~shm_channel() noexcept;
+
+   // What the other process needs to attach; the descriptors stay this channel's.
+   inline std::vector<handed_off> handles() const {
+      return {{memory.get_handle(), shm_memory_kind},
+              {doorbell_of(0U).get_handle(), shm_doorbell_kinds[0]},
+              {doorbell_of(1U).get_handle(), shm_doorbell_kinds[1]}};
+   }
+
+   // False, sending nothing, if the message does not fit in what the peer has left free.
+   inline bool try_send(const void *message, std::size_t size) noexcept {
+      if (size > max_message_size()) {
+         return false;
+      }
+      std::uint64_t record = record_size(size);
+      std::uint64_t t = outbound->tail.load(std::memory_order_relaxed);
+      if (t + record - cached_head > capacity()) {
+         cached_head = outbound->head.load(std::memory_order_acquire);
+         if (t + record - cached_head > capacity()) {
+            return false;
+         }
+      }
+
+      char *slot = outbound_data + (t & (capacity() - 1U));
+      std::uint64_t header = size;
+      std::memcpy(slot, &header, sizeof(header));
+      std::memcpy(slot + sizeof(header), message, size);
+      // Sequentially consistent with respect to the consumer arming itself (see drain()).
+      outbound->tail.store(t + record);
+      if (outbound->consumer_idle.load() && outbound->consumer_idle.exchange(false)) {
+         ring(peer_doorbell.get_handle());
+      }
+      return true;
+   }
+
+   inline std::size_t capacity() const noexcept {
+      return mapping->capacity();
+   }
+
+   inline std::size_t max_message_size() const noexcept {
+      return capacity() - sizeof(std::uint64_t);
+   }
+
+private:
+   static inline std::uint64_t record_size(std::size_t size) noexcept {
+      return sizeof(std::uint64_t) + ((static_cast<std::uint64_t>(size) + 7U) & ~std::uint64_t{7U});
+   }
+
+   static inline void ring(native_handle_type doorbell) noexcept {
+      std::uint64_t one = 1U;
+      // Only fails when the counter would overflow, in which case the peer has a wakeup pending anyway.
+      (void)::write(doorbell, &one, sizeof(one));
+   }
+
+   static inline native_handle_type handle_of_kind(const std::vector<handed_off> &handles, std::uint32_t kind) noexcept {
+      for (const handed_off &h : handles) {
+         if (h.kind == kind) {
+            return h.handle;
+         }
+      }
+      return doorbell_handle{};
+   }
+
+   // Side 0 created the channel and produces into ring 0; its own doorbell wakes it for ring 1.
+   inline const unique_handle<doorbell_handle, int (*)(int)> &doorbell_of(std::size_t direction) const noexcept {
+      return (direction == side) ? peer_doorbell : own_doorbell;
+   }
+
+   void attach();
+   void on_doorbell(mode activation_flags);
+   void drain();
+   void fail(std::uint64_t delivered);
+
+   EventEngine &engine;
+   listener_type listener;
+   std::size_t side;
+   unique_handle<memory_handle, int (*)(int)> memory;
+   unique_handle<doorbell_handle, int (*)(int)> own_doorbell;
+   unique_handle<doorbell_handle, int (*)(int)> peer_doorbell;
+   std::unique_ptr<details_::shm_mapping> mapping;
+   details_::shm_ring *outbound;
+   char *outbound_data;
+   std::uint64_t cached_head;
+   details_::shm_ring *inbound;
+   char *inbound_data;
+   std::uint64_t inbound_head;
+   bool broken;
+};
+
+
+template<class EventEngine>
+inline shm_channel<EventEngine>::shm_channel(EventEngine &e, std::size_t c, listener_type l) :
+   engine(e),
+   listener(l),
+   side(0U),
+   memory({}, &::close),
+   own_doorbell({}, &::close),
+   peer_doorbell({}, &::close),
+   mapping(),
+   outbound(nullptr),
+   outbound_data(nullptr),
+   cached_head(0U),
+   inbound(nullptr),
+   inbound_data(nullptr),
+   inbound_head(0U),
+   broken(false)
+{
+   memory.reset(memory_handle{details_::create_shm(c)});
+   own_doorbell.reset(doorbell_handle{details_::create_doorbell()});
+   peer_doorbell.reset(doorbell_handle{details_::create_doorbell()});
+   attach();
+}
+
+
+template<class EventEngine>
+inline shm_channel<EventEngine>::shm_channel(EventEngine &e, const std::vector<handed_off> &handles, listener_type l) :
+   engine(e),
+   listener(l),
+   side(1U),
+   memory({}, &::close),
+   own_doorbell({}, &::close),
+   peer_doorbell({}, &::close),
+   mapping(),
+   outbound(nullptr),
+   outbound_data(nullptr),
+   cached_head(0U),
+   inbound(nullptr),
+   inbound_data(nullptr),
+   inbound_head(0U),
+   broken(false)
+{
+   memory.reset(memory_handle{handle_of_kind(handles, shm_memory_kind)});
+   own_doorbell.reset(doorbell_handle{handle_of_kind(handles, shm_doorbell_kinds[0])});
+   peer_doorbell.reset(doorbell_handle{handle_of_kind(handles, shm_doorbell_kinds[1])});
+   if (!memory.get_handle().valid() || !own_doorbell.get_handle().valid() || !peer_doorbell.get_handle().valid()) {
+      throw std::system_error(make_error_code(std::errc::invalid_argument), "Missing shared memory channel handle.");
+   }
+   attach();
+}
+
+
+template<class EventEngine>
+inline shm_channel<EventEngine>::~shm_channel() noexcept {
+   doorbell_handle h{own_doorbell.get_handle()};
+   engine.stop_monitoring(h);
+}
+
+
+template<class EventEngine>
+inline void shm_channel<EventEngine>::attach() {
+   mapping = std::make_unique<details_::shm_mapping>(memory.get_handle());
+   outbound = &mapping->ring(side);
+   outbound_data = mapping->data(side);
+   cached_head = outbound->head.load(std::memory_order_acquire);
+   inbound = &mapping->ring(1U - side);
+   inbound_data = mapping->data(1U - side);
+   inbound_head = inbound->head.load(std::memory_order_relaxed);
+   // A doorbell the peer rang before this side was listening is reported as soon as it is registered.
+   engine.template start_monitoring<shm_channel, &shm_channel::on_doorbell>(own_doorbell.get_handle(), mode::read, *this);
+}
+
+
+template<class EventEngine>
+inline void shm_channel<EventEngine>::on_doorbell(mode activation_flags) {
+   (void)activation_flags;
+
+   // Reset the counter before looking at the ring: a ring that lands after the look raises a fresh edge.
+   std::uint64_t rung = 0U;
+   (void)::read(own_doorbell.get_handle(), &rung, sizeof(rung));
+   drain();
+}
+
+
+template<class EventEngine>
+void shm_channel<EventEngine>::drain() {
+   if (broken) {
+      return;
+   }
+
+   // The head is this side's own; the copy in the ring is only for the producer to read.
+   std::uint64_t h = inbound_head;
+   std::uint64_t budget = h + capacity();
+   for (;;) {
+      std::uint64_t t = inbound->tail.load(std::memory_order_acquire);
+      if (t - h > capacity()) {
+         fail(h);
+         return;
+      }
+      while ((h != t) && (h < budget)) {
+         const char *slot = inbound_data + (h & (capacity() - 1U));
+         std::uint64_t size = 0U;
+         std::memcpy(&size, slot, sizeof(size));
+         if ((size > max_message_size()) || (record_size(static_cast<std::size_t>(size)) > t - h)) {
+            fail(h);
+            return;
+         }
+         h += record_size(static_cast<std::size_t>(size));
+         listener.execute(slot + sizeof(size), static_cast<std::size_t>(size), std::error_code{});
+      }
+      // The producer may reuse the space only once every message in it has been delivered.
+      inbound_head = h;
+      inbound->head.store(h, std::memory_order_release);
+
+      if (h != t) {
+         // Leave the rest for the next iteration rather than starve other handlers.
+         ring(own_doorbell.get_handle());
+         return;
+      }
+
+      // Arm, then look again: a producer that published after the look above either sees the flag or has its
+      // message found here.
+      inbound->consumer_idle.store(true);
+      if (inbound->tail.load() == h) {
+         return;
+      }
+   }
+}
+
+
+template<class EventEngine>
+void shm_channel<EventEngine>::fail(std::uint64_t delivered) {
+   broken = true;
+   inbound_head = delivered;
+   inbound->head.store(delivered, std::memory_order_release);
+   listener.execute(nullptr, 0U, make_error_code(std::errc::bad_message));
+}
+
+}
+
+#endif
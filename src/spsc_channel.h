@@ -0,0 +1,151 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_SPSC_CHANNEL_H__
+#define EPOLLING_SPSC_CHANNEL_H__
+
+#include "activation.h"
+#include "notification.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace epolling {
+
+// A bounded single producer, single consumer ring for passing messages to the engine that owns the channel.
+// The consumer side is registered with that engine: a notification wakes it, and it drains whatever is in the
+// ring, up to one ring's worth per iteration, calling the listener for each message on the polling thread.
+//
+// The producer only rings the notification when the consumer may have gone idle, i.e. when the ring was found
+// empty after a drain, so a steady stream of messages costs no system calls.  Producer state, consumer state
+// and the idle flag each have a cache line of their own.
+//
+// try_send() must only ever be called from one thread at a time.  T must be default constructible and move
+// assignable.
+template<class T>
+class spsc_channel final {
+public:
+   typedef T value_type;
+   typedef basic_activation<void(T&)> listener_type;
+
+   template<class U, void (U::*OnMessage)(T&), class V>
+   static inline listener_type create_listener(V &object) noexcept {
+      return listener_type::template create<U, OnMessage>(object);
+   }
+
+   // Capacity is rounded up to a power of two.
+   template<class ES, template<class> class D>
+   spsc_channel(event_engine<ES, D> &consumer, std::size_t capacity, listener_type l);
+   spsc_channel() = delete;
+   spsc_channel(const spsc_channel &) = delete;
+   spsc_channel & operator =(const spsc_channel &) = delete;
+
+   // False, leaving value alone, if the ring is full.
+   inline bool try_send(T &&value) {
+      std::size_t t = tail.load(std::memory_order_relaxed);
+      if (t - cached_head == ring.size()) {
+         cached_head = head.load(std::memory_order_acquire);
+         if (t - cached_head == ring.size()) {
+            return false;
+         }
+      }
+
+      ring[t & mask] = std::move(value);
+      // Sequentially consistent with respect to the consumer arming itself (see drain()).
+      tail.store(t + 1U);
+      if (consumer_idle.load() && consumer_idle.exchange(false)) {
+         doorbell.set(1);
+      }
+      return true;
+   }
+
+   inline bool try_send(const T &value) {
+      T copy{value};
+      return try_send(std::move(copy));
+   }
+
+   inline std::size_t capacity() const noexcept {
+      return ring.size();
+   }
+
+private:
+   static inline std::size_t round_up(std::size_t n) noexcept {
+      std::size_t result = 1U;
+      while (result < n) {
+         result <<= 1U;
+      }
+      return result;
+   }
+
+   void drain(uint64_t value);
+
+   const std::size_t mask;
+   std::vector<T> ring;
+   listener_type listener;
+
+   alignas(64) std::atomic<std::size_t> tail;
+   std::size_t cached_head;
+
+   alignas(64) std::atomic<std::size_t> head;
+
+   alignas(64) std::atomic<bool> consumer_idle;
+
+   alignas(64) notification doorbell;
+};
+
+
+template<class T>
+void spsc_channel<T>::drain(uint64_t value) {
+   (void)value;
+
+   std::size_t h = head.load(std::memory_order_relaxed);
+   std::size_t budget = ring.size();
+   for (;;) {
+      std::size_t t = tail.load(std::memory_order_acquire);
+      for (; (h != t) && (budget > 0U); --budget) {
+         // Hand the slot back before the listener runs, so that a slow listener does not hold the producer up.
+         T message{std::move(ring[h & mask])};
+         head.store(++h, std::memory_order_release);
+         listener.execute(message);
+      }
+
+      if (h != t) {
+         // Leave the rest for the next iteration rather than starve other handlers.
+         doorbell.set(1);
+         return;
+      }
+
+      // Arm, then look again: a producer that published after the look above either sees the flag or has its
+      // message found here.
+      consumer_idle.store(true);
+      if (tail.load() == h) {
+         return;
+      }
+   }
+}
+
+}
+
+
+#include "event_engine.h"
+
+namespace epolling {
+
+template<class T>
+template<class ES, template<class> class D>
+inline spsc_channel<T>::spsc_channel(event_engine<ES, D> &consumer, std::size_t c, listener_type l) :
+   mask(round_up(c) - 1U),
+   ring(mask + 1U),
+   listener(l),
+   tail(0U),
+   cached_head(0U),
+   head(0U),
+   consumer_idle(true),
+   doorbell(consumer, notification::behavior::conditional, 0,
+            notification::create_listener<spsc_channel, &spsc_channel::drain>(*this))
+{
+}
+
+}
+
+#endif
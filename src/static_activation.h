@@ -0,0 +1,124 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_STATIC_ACTIVATION_H__
+#define EPOLLING_STATIC_ACTIVATION_H__
+
+#include "activation.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace epolling {
+
+template<class T, class MemberFunction, MemberFunction OnActivation> struct activation_handler;
+template<class Signature, class ... Handlers> struct basic_static_activation;
+
+
+template<class T, class R, class ... Args, R (T::*OnActivation)(Args...)>
+struct activation_handler<T, R (T::*)(Args...), OnActivation> final {
+   template<class ... A>
+   static inline R invoke(void *object, A && ... args) {
+      using std::forward;
+
+      assert(object != nullptr);
+      return (static_cast<T*>(object)->*OnActivation)(forward<A>(args)...);
+   }
+};
+
+
+namespace details_ {
+
+template<class Handler, class ... Handlers> struct handler_index;
+
+template<class Handler>
+struct handler_index<Handler> : std::integral_constant<std::size_t, 0> {
+};
+
+template<class Handler, class ... Rest>
+struct handler_index<Handler, Handler, Rest...> : std::integral_constant<std::size_t, 0> {
+};
+
+template<class Handler, class First, class ... Rest>
+struct handler_index<Handler, First, Rest...> : std::integral_constant<std::size_t, 1 + handler_index<Handler, Rest...>::value> {
+};
+
+
+// Unrolls into a chain of comparisons against consecutive constants, which the compiler lowers to a switch with
+// every handler inlined into its case.
+template<std::size_t Index, class ... Handlers> struct static_dispatch;
+
+template<std::size_t Index, class Last>
+struct static_dispatch<Index, Last> final {
+   template<class ... A>
+   static inline auto dispatch(std::size_t tag, void *object, A && ... args) {
+      using std::forward;
+
+      assert(tag == Index);
+      (void)tag;
+      return Last::invoke(object, forward<A>(args)...);
+   }
+};
+
+template<std::size_t Index, class First, class ... Rest>
+struct static_dispatch<Index, First, Rest...> final {
+   template<class ... A>
+   static inline auto dispatch(std::size_t tag, void *object, A && ... args) {
+      using std::forward;
+
+      if (tag == Index) {
+         return First::invoke(object, forward<A>(args)...);
+      }
+      return static_dispatch<Index + 1, Rest...>::dispatch(tag, object, forward<A>(args)...);
+   }
+};
+
+}
+
+
+// An activation for a closed set of handler types known at compile time.  In place of a function pointer it
+// carries the position of its handler in the set, so dispatching is a switch instead of an indirect call through
+// a trampoline.
+template<class R, class ... Args, class ... Handlers>
+struct basic_static_activation<R(Args...), Handlers...> final {
+   static_assert(sizeof...(Handlers) > 0, "A static activation requires at least one handler.");
+   static_assert(sizeof...(Handlers) <= UINT8_MAX, "A static activation supports at most 255 handlers.");
+
+   typedef std::uint8_t tag_type;
+   typedef R result_type;
+   template<class T> using member_type = R (T::*)(Args...);
+
+   tag_type tag;
+   void *object;
+
+   template<class T, member_type<T> OnActivation, class U>
+   static inline basic_static_activation create(U &object) noexcept {
+      constexpr std::size_t index = details_::handler_index<activation_handler<T, member_type<T>, OnActivation>, Handlers...>::value;
+      static_assert(index < sizeof...(Handlers), "Handler is not part of the static activation's handler set.");
+
+      return {static_cast<tag_type>(index), static_cast<T*>(&object)};
+   }
+
+   inline R execute(Args && ... args) {
+      using std::forward;
+
+      return details_::static_dispatch<0, Handlers...>::dispatch(tag, object, forward<Args>(args)...);
+   }
+
+   inline std::uintptr_t dispatch_key() const noexcept {
+      return tag;
+   }
+
+   inline const void *target() const noexcept {
+      return object;
+   }
+};
+
+
+template<class R, class ... Args, class ... Handlers>
+struct activation_traits<basic_static_activation<R(Args...), Handlers...>> {
+   using activation_type = basic_static_activation<R(Args...), Handlers...>;
+};
+
+}
+
+#endif
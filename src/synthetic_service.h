@@ -0,0 +1,313 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_SYNTHETIC_SERVICE_H__
+#define EPOLLING_SYNTHETIC_SERVICE_H__
+
+#include "activation.h"
+#include "handle.h"
+#include "mode.h"
+#include "signal_handle.h"
+#include "bits/poll_timeout.h"
+#include "bits/simulated_registration.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <experimental/executor>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <random>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace epolling {
+
+// Describes the readiness a synthetic_service makes up.  Events go to the handles in
+// [first_handle, first_handle + handle_count) that are registered, with their flags drawn from the weights below
+// and masked with each registration's interest.  A share of them can be concentrated on a few hot handles.
+struct synthetic_load {
+   native_handle_type first_handle;
+   std::size_t handle_count;
+   // Events per poll, at most; fewer when the rate says fewer are due, and never more than the engine asks for.
+   std::size_t batch_size;
+   // 0 for as fast as the engine polls.
+   double events_per_second;
+   unsigned read_weight;
+   unsigned write_weight;
+   unsigned read_write_weight;
+   unsigned hangup_weight;
+   // The first hot_handles handles of the range get hot_share of the events.
+   std::size_t hot_handles;
+   double hot_share;
+   unsigned seed;
+};
+
+
+// An EventService without a kernel: poll() dispatches readiness generated in memory according to a
+// synthetic_load, so that the cost of the engine and the handlers can be measured apart from that of epoll.
+// The sequence of events is drawn once, when the load is set, and replayed in a loop, so generating it costs
+// nothing while polling and two runs with the same load see the same events.
+//
+// Registrations outside the load's range get none of the made up events.  They are only looked at while no load
+// is set, or one with no batch, when poll() waits on them with poll(2) for up to its timeout; that way the engine's own notification
+// can still end a run() that has nothing to do.  set_load() keeps the registrations the new range still covers and forgets the rest, as it
+// would have on registering them under the new load; it must not be called while the engine polls.
+template<class Activation>
+class basic_synthetic_service : public std::experimental::execution_context::service {
+public:
+   using activation_type = Activation;
+
+   constexpr static std::size_t sequence_length = 1U << 16U;
+
+   explicit basic_synthetic_service(std::experimental::execution_context &e) :
+      std::experimental::execution_context::service(e),
+      load{0, 0U, 0U, 0.0, 1U, 0U, 0U, 0U, 0U, 0.0, 0U},
+      registrations(),
+      outside_lock(),
+      outside(),
+      sequence(),
+      next_event(0U),
+      started(),
+      delivered(0U),
+      total_delivered(0U)
+   {
+   }
+
+   virtual ~basic_synthetic_service() noexcept final override {
+   }
+
+   void set_load(const synthetic_load &l);
+
+   inline std::uint64_t events_delivered() const noexcept {
+      return total_delivered.load(std::memory_order_relaxed);
+   }
+
+   template<class T, void (T::*OnActivation)(mode), class Tag, class Impl, Impl Invalid, class U>
+   inline std::error_code start_monitoring(const handle<Tag, Impl, Invalid> &h, mode flags, U &object) noexcept {
+      registration *r = find(h);
+      if (r == nullptr) {
+         r = find_outside(h, true);
+      }
+      r->activation = activation_type::template create<T, OnActivation>(object);
+      r->interest = flags;
+      r->registered.store(true, std::memory_order_release);
+      return {};
+   }
+
+   template<class Tag, class Impl, Impl Invalid>
+   inline std::error_code update_monitoring(const handle<Tag, Impl, Invalid> &h, mode flags) noexcept {
+      registration *r = find(h);
+      if (r == nullptr) {
+         r = find_outside(h, false);
+      }
+      if (r != nullptr) {
+         r->interest = flags;
+      }
+      return {};
+   }
+
+   // May be called from any thread, including from a handler.
+   template<class Tag, class Impl, Impl Invalid>
+   inline std::error_code stop_monitoring(const handle<Tag, Impl, Invalid> &h) noexcept {
+      registration *r = find(h);
+      if (r == nullptr) {
+         r = find_outside(h, false);
+      }
+      if (r != nullptr) {
+         r->registered.store(false, std::memory_order_release);
+      }
+      return {};
+   }
+
+   std::pair<std::error_code, bool> poll(std::size_t max_events, std::chrono::nanoseconds timeout);
+
+   inline std::error_code block_signal(const signal_handle &signum) noexcept {
+      (void)signum;
+      return {};
+   }
+
+private:
+   typedef details_::simulated_registration<activation_type> registration;
+
+   struct event {
+      std::uint32_t index;
+      mode flags;
+   };
+
+   inline registration *find(native_handle_type h) noexcept {
+      auto offset = static_cast<std::size_t>(h - load.first_handle);
+      return ((h >= load.first_handle) && (offset < registrations.size())) ? &registrations[offset] : nullptr;
+   }
+
+   // Entries are never removed, so a registration found here stays put; stopping one only clears its flag.
+   inline registration *find_outside(native_handle_type h, bool create) {
+      std::lock_guard<std::mutex> l{outside_lock};
+      for (auto &o : outside) {
+         if (o.first == h) {
+            return o.second.get();
+         }
+      }
+      if (!create) {
+         return nullptr;
+      }
+      outside.emplace_back(h, std::make_unique<registration>());
+      return outside.back().second.get();
+   }
+
+   std::size_t events_due(std::size_t max_events, std::chrono::nanoseconds timeout);
+
+   std::size_t wait_outside(std::chrono::nanoseconds timeout);
+
+   virtual void shutdown_service() final override {
+   }
+
+   synthetic_load load;
+   std::vector<registration> registrations;
+   std::mutex outside_lock;
+   std::vector<std::pair<native_handle_type, std::unique_ptr<registration>>> outside;
+   std::vector<event> sequence;
+   std::size_t next_event;
+   std::chrono::steady_clock::time_point started;
+   std::uint64_t delivered;
+   std::atomic<std::uint64_t> total_delivered;
+};
+
+
+using synthetic_service = basic_synthetic_service<basic_activation<void(mode)>>;
+
+
+template<class Activation>
+void basic_synthetic_service<Activation>::set_load(const synthetic_load &l) {
+   std::vector<registration> fresh(l.handle_count);
+   for (std::size_t i = 0U; i < registrations.size(); ++i) {
+      native_handle_type h = load.first_handle + static_cast<native_handle_type>(i);
+      auto offset = static_cast<std::size_t>(h - l.first_handle);
+      if ((h >= l.first_handle) && (offset < fresh.size()) && registrations[i].registered.load(std::memory_order_relaxed)) {
+         fresh[offset].activation = registrations[i].activation;
+         fresh[offset].interest = registrations[i].interest;
+         fresh[offset].registered.store(true, std::memory_order_relaxed);
+      }
+   }
+   load = l;
+   registrations.swap(fresh);
+
+   std::mt19937 random{load.seed};
+   std::discrete_distribution<int> pick_flags{static_cast<double>(load.read_weight), static_cast<double>(load.write_weight),
+                                              static_cast<double>(load.read_write_weight), static_cast<double>(load.hangup_weight)};
+   const mode flags[] = {mode::read, mode::write, mode::read_write, mode::read | mode::hangup};
+   std::bernoulli_distribution pick_hot{(load.hot_handles > 0U) ? load.hot_share : 0.0};
+   std::uniform_int_distribution<std::size_t> pick_hot_handle{0U, std::max<std::size_t>(load.hot_handles, 1U) - 1U};
+   std::uniform_int_distribution<std::size_t> pick_handle{0U, std::max<std::size_t>(load.handle_count, 1U) - 1U};
+
+   sequence.clear();
+   if (load.handle_count > 0U) {
+      sequence.reserve(sequence_length);
+      for (std::size_t i = 0U; i < sequence_length; ++i) {
+         std::size_t index = pick_hot(random) ? pick_hot_handle(random) : pick_handle(random);
+         sequence.push_back({static_cast<std::uint32_t>(std::min(index, load.handle_count - 1U)), flags[pick_flags(random)]});
+      }
+   }
+   next_event = 0U;
+   started = std::chrono::steady_clock::now();
+   delivered = 0U;
+}
+
+
+template<class Activation>
+std::size_t basic_synthetic_service<Activation>::events_due(std::size_t max_events, std::chrono::nanoseconds timeout) {
+   using std::chrono::duration;
+   using std::chrono::duration_cast;
+   using std::chrono::steady_clock;
+
+   std::size_t wanted = std::min(max_events, load.batch_size);
+   if ((load.events_per_second <= 0.0) || (wanted == 0U)) {
+      return wanted;
+   }
+
+   // Events are due at a steady rate from when the load was set; a late poll catches up, a batch at a time.
+   auto due_at = [this](std::uint64_t n) {
+      return started + duration_cast<steady_clock::duration>(duration<double>{static_cast<double>(n) / load.events_per_second});
+   };
+   auto now = steady_clock::now();
+   if (due_at(delivered + 1U) > now) {
+      auto wait = due_at(delivered + 1U) - now;
+      if ((timeout >= std::chrono::nanoseconds::zero()) && (wait > timeout)) {
+         std::this_thread::sleep_for(timeout);
+         return 0U;
+      }
+      std::this_thread::sleep_for(wait);
+      now = steady_clock::now();
+   }
+
+   auto elapsed = duration<double>{now - started}.count();
+   auto total_due = static_cast<std::uint64_t>(elapsed * load.events_per_second);
+   return static_cast<std::size_t>(std::min<std::uint64_t>(wanted, (total_due > delivered) ? (total_due - delivered) : 1U));
+}
+
+
+template<class Activation>
+std::size_t basic_synthetic_service<Activation>::wait_outside(std::chrono::nanoseconds timeout) {
+   std::vector<::pollfd> watched;
+   std::vector<registration *> targets;
+   {
+      std::lock_guard<std::mutex> l{outside_lock};
+      for (auto &o : outside) {
+         mode interest = o.second->interest;
+         if (o.second->registered.load(std::memory_order_acquire)) {
+            short events = static_cast<short>((((interest & mode::read) != mode::none) ? (POLLIN | POLLPRI) : 0) |
+                                              (((interest & mode::write) != mode::none) ? POLLOUT : 0));
+            watched.push_back({o.first, events, 0});
+            targets.push_back(o.second.get());
+         }
+      }
+   }
+
+   std::size_t executed = 0U;
+   if (::poll(watched.data(), watched.size(), details_::to_poll_timeout(timeout)) > 0) {
+      for (std::size_t i = 0U; i < watched.size(); ++i) {
+         short ready = watched[i].revents;
+         if ((ready & POLLNVAL) != 0) {
+            // Closed without being stopped, as a notification is; there is nobody left to tell.
+            targets[i]->registered.store(false, std::memory_order_release);
+            continue;
+         }
+         mode flags = ((ready & (POLLIN | POLLPRI)) ? mode::read : mode::none) |
+                      ((ready & POLLOUT) ? mode::write : mode::none) |
+                      ((ready & POLLHUP) ? mode::hangup : mode::none) |
+                      ((ready & POLLERR) ? mode::error : mode::none);
+         if ((flags != mode::none) && targets[i]->fire(flags)) {
+            ++executed;
+         }
+      }
+   }
+   return executed;
+}
+
+
+template<class Activation>
+std::pair<std::error_code, bool> basic_synthetic_service<Activation>::poll(std::size_t max_events, std::chrono::nanoseconds timeout) {
+   if (sequence.empty() || (load.batch_size == 0U)) {
+      return std::make_pair(std::error_code{}, wait_outside(timeout) > 0U);
+   }
+
+   std::size_t due = events_due(max_events, timeout);
+   std::size_t executed = 0U;
+   for (std::size_t i = 0U; i < due; ++i) {
+      const event &e = sequence[next_event];
+      next_event = (next_event + 1U) % sequence.size();
+
+      if (registrations[e.index].fire(e.flags)) {
+         ++executed;
+      }
+   }
+
+   delivered += due;
+   total_delivered.store(total_delivered.load(std::memory_order_relaxed) + executed, std::memory_order_relaxed);
+   return std::make_pair(std::error_code{}, executed > 0U);
+}
+
+}
+
+#endif
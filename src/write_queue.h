@@ -0,0 +1,206 @@
+// vim: sw=3 ts=3 expandtab cindent
+#ifndef EPOLLING_WRITE_QUEUE_H__
+#define EPOLLING_WRITE_QUEUE_H__
+
+#include "activation.h"
+#include "handle.h"
+#include "mode.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <deque>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace epolling {
+
+// Outbound data for a non-blocking stream handle.  Messages are queued without touching the handle and go out
+// together in as few writev() calls as possible on flush(), which is meant to be called once per iteration after
+// whatever produced them has run.  Write interest is only added, through update_monitoring(), when the kernel
+// refuses more data, and is dropped again once the queue has drained.  Sockets are written with sendmsg() and
+// MSG_NOSIGNAL so that a vanished peer is an EPIPE rather than a SIGPIPE; anything else falls back on writev().
+//
+// The handle stays registered by its owner with the interest passed in here, and the owner's handler forwards
+// mode::write to on_writable().  The listener is told to pause once more than the high watermark is queued, and
+// to resume once no more than the low watermark is.
+//
+// All member functions must be called on the engine's polling thread.
+template<class EventEngine>
+class write_queue final {
+   struct tag {};
+
+public:
+   typedef handle<tag, int, -1> handle_type;
+   typedef std::vector<char> message_type;
+
+   enum class backpressure {
+      pause,
+      resume
+   };
+
+   typedef basic_activation<void(backpressure)> listener_type;
+
+   template<class T, void (T::*OnBackpressure)(backpressure), class U>
+   static inline listener_type create_listener(U &object) noexcept {
+      return listener_type::template create<T, OnBackpressure>(object);
+   }
+
+   inline write_queue(EventEngine &e, native_handle_type stream, mode flags, std::size_t low_watermark,
+                      std::size_t high_watermark, listener_type l) :
+      engine(e),
+      destination(stream),
+      interest(flags),
+      low(low_watermark),
+      high(high_watermark),
+      listener(l),
+      messages(),
+      offset(0U),
+      bytes_queued(0U),
+      iovecs(),
+      write_armed(false),
+      paused(false),
+      is_socket(true)
+   {
+      iovecs.reserve(max_iovecs);
+   }
+
+   write_queue() = delete;
+   write_queue(const write_queue &) = delete;
+   write_queue & operator =(const write_queue &) = delete;
+
+   inline void enqueue(message_type message) {
+      using std::move;
+
+      if (!message.empty()) {
+         bytes_queued += message.size();
+         messages.push_back(move(message));
+         if (!paused && (bytes_queued > high)) {
+            paused = true;
+            listener.execute(backpressure::pause);
+         }
+      }
+   }
+
+   inline void enqueue(const void *data, std::size_t size) {
+      auto *first = static_cast<const char*>(data);
+      enqueue(message_type(first, first + size));
+   }
+
+   // Writes as much as the kernel takes.  Running out of room is not an error; anything else is, and leaves the
+   // queue as it was.
+   std::error_code flush();
+
+   inline std::error_code on_writable() {
+      return flush();
+   }
+
+   inline std::size_t queued() const noexcept {
+      return bytes_queued;
+   }
+
+   inline bool empty() const noexcept {
+      return messages.empty();
+   }
+
+private:
+   constexpr static std::size_t max_iovecs = IOV_MAX;
+
+   inline ssize_t gather_write() noexcept {
+      if (is_socket) {
+         ::msghdr message{};
+         message.msg_iov = iovecs.data();
+         message.msg_iovlen = iovecs.size();
+         return ::sendmsg(destination, &message, MSG_NOSIGNAL);
+      }
+      return ::writev(destination, iovecs.data(), static_cast<int>(iovecs.size()));
+   }
+
+   void consume(std::size_t written);
+   void arm(bool want_write);
+
+   EventEngine &engine;
+   handle_type destination;
+   const mode interest;
+   const std::size_t low;
+   const std::size_t high;
+   listener_type listener;
+   std::deque<message_type> messages;
+   std::size_t offset;
+   std::size_t bytes_queued;
+   std::vector<::iovec> iovecs;
+   bool write_armed;
+   bool paused;
+   bool is_socket;
+};
+
+
+template<class EventEngine>
+std::error_code write_queue<EventEngine>::flush() {
+   using std::min;
+
+   while (!messages.empty()) {
+      iovecs.clear();
+      std::size_t skip = offset;
+      for (auto m = messages.begin(); (m != messages.end()) && (iovecs.size() < max_iovecs); ++m, skip = 0U) {
+         iovecs.push_back({m->data() + skip, m->size() - skip});
+      }
+
+      ssize_t written = gather_write();
+      if (written < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         if ((errno == ENOTSOCK) && is_socket) {
+            is_socket = false;
+            continue;
+         }
+         if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            arm(true);
+            return {};
+         }
+         return make_error_code(static_cast<std::errc>(errno));
+      }
+      consume(static_cast<std::size_t>(written));
+   }
+
+   arm(false);
+   return {};
+}
+
+
+template<class EventEngine>
+void write_queue<EventEngine>::consume(std::size_t written) {
+   bytes_queued -= written;
+   while (written > 0U) {
+      std::size_t remaining = messages.front().size() - offset;
+      if (written < remaining) {
+         offset += written;
+         break;
+      }
+      written -= remaining;
+      offset = 0U;
+      messages.pop_front();
+   }
+
+   if (paused && (bytes_queued <= low)) {
+      paused = false;
+      listener.execute(backpressure::resume);
+   }
+}
+
+
+template<class EventEngine>
+void write_queue<EventEngine>::arm(bool want_write) {
+   if (want_write != write_armed) {
+      write_armed = want_write;
+      engine.update_monitoring(destination, want_write ? (interest | mode::write) : interest);
+   }
+}
+
+}
+
+#endif